@@ -0,0 +1,288 @@
+
+#include "blockHasher.h"
+
+
+const array<char, 64 << 10> blockHasher::zero_segment{};
+
+
+blockHasher::blockHasher(const string& input, uintmax_t input_size, uintmax_t bs, uintmax_t read_size,
+						 const vector<string>& algorithms, shared_ptr<ioThrottle> throttle,
+						 bool zstd_seekable) noexcept(false)
+{
+	if ((!bs) || (!read_size))
+		throw logic_error(std::string("Incorrect block or read size"));
+
+	this->input_file = input;
+	this->inputfile_size = input_size;
+	this->block_size = bs;
+	this->segment_size = read_size;
+	this->io_throttle = throttle;
+	this->hash_algorithms = algorithms;
+
+	for (const auto& algorithm : algorithms)
+		engines.push_back(hashEngine::create(algorithm));
+	this->engines_dirty = false;
+	this->zero_padding = true;
+
+	if (zstd_seekable)
+		this->zstd_input = make_unique<zstdSeekableReader>(input, io_throttle);
+}
+
+
+void blockHasher::reset_input(const string& input, uintmax_t input_size) noexcept(false)
+{
+	if_input.clear();
+	if (if_input.is_open())
+		if_input.close();
+
+	this->input_file = input;
+	this->inputfile_size = input_size;
+
+	if (zstd_input)
+		this->zstd_input = make_unique<zstdSeekableReader>(input, io_throttle);
+}
+
+
+void blockHasher::pad_last_block(bool padding) noexcept(true)
+{
+	this->zero_padding = padding;
+}
+
+
+void blockHasher::copy_to(const string& destination) noexcept(true)
+{
+	this->copy_destination = destination;
+}
+
+
+bool blockHasher::hash_blocks(const uintmax_t begin_block, const uintmax_t end_block,
+							  const function<void(uintmax_t, const vector<string>&)>& on_block,
+							  const atomic<bool>& stop) noexcept(false)
+{
+	// Stream of a failed reading is reopened
+	if ((if_input.is_open()) && (!if_input.good())) {
+		if_input.clear();
+		if_input.close();
+	}
+	if ((!zstd_input) && (!if_input.is_open())) {
+		if_input.exceptions( ifstream::failbit | ifstream::badbit );
+		if_input.open(input_file, ios_base::in | ios_base::binary);
+		if (!if_input.is_open())
+			throw runtime_error(input_file + " error on open");
+	}
+
+	// Interrupted computations have left a partial block in the engines
+	if (engines_dirty) {
+		for (size_t alg = 0; alg < engines.size(); ++alg)
+			engines[alg] = hashEngine::create(hash_algorithms[alg]);
+		engines_dirty = false;
+	}
+
+	for (auto& segment : segments)
+		if (segment.size() != segment_size)
+			segment.resize(segment_size);
+
+	// Read the range as a stream of fixed-size segments
+	const uintmax_t data_end = min(end_block * block_size, inputfile_size);
+	uintmax_t read_pos = min(begin_block * block_size, data_end);
+
+	// Copy of the range is written at the same offsets
+	fstream of_copy;
+	if (!copy_destination.empty()) {
+		of_copy.exceptions( fstream::failbit | fstream::badbit );
+		of_copy.open(copy_destination, ios_base::in | ios_base::out | ios_base::binary);
+		if (!of_copy.is_open())
+			throw runtime_error(copy_destination + " error on open");
+		of_copy.seekp(read_pos);
+	}
+
+	auto read_input = [&read_pos, this](char* segment, uintmax_t length) {
+		// Frames are decompressed by the reading thread, in parallel with hashing
+		if (zstd_input)
+			zstd_input->read(read_pos, segment, length);
+		else
+			if_input.read(segment, length);
+	};
+	auto read_segment = [&read_input, &read_pos, &of_copy, data_end, this](char* segment) {
+		const uintmax_t length = min(segment_size, data_end - read_pos);
+		// Compressed input is throttled by its reader: only the device's
+		// reads are charged and timed, not the uncompressed bytes and decompression
+		if ((io_throttle) && (!zstd_input)) {
+			io_throttle->acquire(length);
+			const auto read_start = chrono::steady_clock::now();
+			read_input(segment, length);
+			io_throttle->report(length, chrono::steady_clock::now() - read_start);
+		} else
+			read_input(segment, length);
+		if (of_copy.is_open())
+			of_copy.write(segment, length);
+		read_pos += length;
+		return length;
+	};
+
+	uintmax_t i_block = begin_block;
+	uintmax_t block_filled = 0;
+	vector<string> cipherblocks(engines.size());
+
+	// Every piece of data is fed to all of the hash engines one after
+	// another by cache-sized strides, so the next engine gets the stride
+	// while it is still in CPU cache
+	auto hash_piece = [this](const char* piece, uintmax_t length) {
+		if (engines.size() == 1) {
+			engines.front()->process_bytes(piece, length);
+			return;
+		}
+		for (uintmax_t offset = 0; offset < length; offset += hash_stride) {
+			const size_t stride = static_cast<size_t>(min(hash_stride, length - offset));
+			for (auto& engine : engines)
+				engine->process_bytes(piece + offset, stride);
+		}
+	};
+
+	auto complete_block = [&]() {
+		// Padding the very last block with zeros to the block size
+		for (uintmax_t padding = zero_padding ? block_size - block_filled : 0; padding > 0; ) {
+			const uintmax_t length = min(padding, static_cast<uintmax_t>(zero_segment.size()));
+			hash_piece(zero_segment.data(), length);
+			padding -= length;
+		}
+
+		for (size_t alg = 0; alg < engines.size(); ++alg) {
+			cipherblocks[alg].clear();
+			engines[alg]->append_digest(cipherblocks[alg]);
+		}
+		on_block(i_block, cipherblocks);
+
+		block_filled = 0;
+		++i_block;
+	};
+
+	// Segments may straddle blocks' boundaries
+	auto hash_segment = [&](const char* segment, uintmax_t length) {
+		for (uintmax_t offset = 0; offset < length; ) {
+			const uintmax_t piece = min(length - offset, block_size - block_filled);
+			hash_piece(segment + offset, piece);
+			offset += piece;
+			block_filled += piece;
+			if (block_filled == block_size)
+				complete_block();
+		}
+	};
+
+	if ((read_pos < data_end) && (!zstd_input))
+		if_input.seekg(read_pos);
+
+	engines_dirty = true;
+
+	// A single segment (e.g. a small probe) isn't worth the reader thread
+	if (data_end - read_pos <= segment_size) {
+		if (stop.load(memory_order_acquire))
+			return false;
+		if (read_pos < data_end)
+			hash_segment(segments[0].data(), read_segment(segments[0].data()));
+	} else if (!stream_segments(data_end - read_pos, read_segment, hash_segment, stop))
+		return false;
+
+	// The last block of the input file is (partially) beyond its end
+	while (i_block < end_block)
+		complete_block();
+	engines_dirty = false;
+
+	if (of_copy.is_open())
+		of_copy.close();
+
+	return true;
+}
+
+
+bool blockHasher::stream_segments(uintmax_t length, const function<uintmax_t(char*)>& read_segment,
+								  const function<void(const char*, uintmax_t)>& hash_segment,
+								  const atomic<bool>& stop) noexcept(false)
+{
+	// One reader thread per call fills the free one of two segments' slots
+	// ahead of hashing, so the next read overlaps hashing of the current segment
+	array<uintmax_t, 2> slot_length{0, 0};
+	array<bool, 2> slot_ready{false, false};
+	bool reader_done = false;
+	bool reader_abort = false;
+	exception_ptr read_error;
+	mutex slots_mutex;
+	condition_variable slots_notification;
+
+	thread reader([&]() {
+		try {
+			for (uint slot = 0; length > 0; slot ^= 1) {
+				{
+					auto lock = unique_lock<mutex>(slots_mutex);
+					slots_notification.wait(lock, [&] { return (!slot_ready[slot]) || reader_abort; });
+					if (reader_abort)
+						break;
+				}
+				const uintmax_t read_length = read_segment(segments[slot].data());
+				length -= read_length;
+				{
+					auto lock = lock_guard<mutex>(slots_mutex);
+					slot_length[slot] = read_length;
+					slot_ready[slot] = true;
+				}
+				slots_notification.notify_all();
+			}
+		}
+		catch (...) {
+			auto lock = lock_guard<mutex>(slots_mutex);
+			read_error = current_exception();
+		}
+		{
+			auto lock = lock_guard<mutex>(slots_mutex);
+			reader_done = true;
+		}
+		slots_notification.notify_all();
+	});
+
+	auto stop_reader = [&]() {
+		{
+			auto lock = lock_guard<mutex>(slots_mutex);
+			reader_abort = true;
+		}
+		slots_notification.notify_all();
+		if (reader.joinable())
+			reader.join();
+	};
+
+	try {
+		for (uint slot = 0; ; slot ^= 1) {
+			uintmax_t slot_data;
+			{
+				auto lock = unique_lock<mutex>(slots_mutex);
+				slots_notification.wait(lock, [&] { return slot_ready[slot] || reader_done; });
+				if (!slot_ready[slot]) {
+					if (read_error)
+						rethrow_exception(read_error);
+					break;
+				}
+				slot_data = slot_length[slot];
+			}
+
+			if (stop.load(memory_order_acquire)) {
+				stop_reader();
+				return false;
+			}
+
+			hash_segment(segments[slot].data(), slot_data);
+
+			// Slot is free for the next read
+			{
+				auto lock = lock_guard<mutex>(slots_mutex);
+				slot_ready[slot] = false;
+			}
+			slots_notification.notify_all();
+		}
+	}
+	catch (...) {
+		stop_reader();
+		throw;
+	}
+	stop_reader();
+
+	return true;
+}
@@ -0,0 +1,214 @@
+
+#ifndef BLOCKHASHER_H_
+#define BLOCKHASHER_H_
+
+#include <fstream>
+#include <array>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+
+#include "hashEngine.h"
+#include "ioThrottle.h"
+#include "zstdSeekableReader.h"
+
+
+/**
+ * @class blockHasher
+ * @brief Computes hash values of a file's range of blocks (last file's block
+ * padded with zeroes to the block size). The range is read as a stream of
+ * fixed-size segments, double-buffered (the next segment is read by a reader
+ * thread, kept for the whole range, while the current one is hashed), so memory
+ * consumption doesn't depend on the block size.
+ * Every segment is hashed with all of the chosen algorithms one after another
+ * by cache-sized strides.
+ * Input file in the zstd seekable format can be hashed by its uncompressed contents.
+ * Read data can be copied to a destination file at the same offsets.
+ * A range fitting into one segment is read synchronously, without the reader
+ * thread. The input file stays open between calls, and an instance can be
+ * retargeted to another file, so a thread reuses one instance for many files.
+ * One instance is used by one thread.
+ */
+class blockHasher
+{
+protected:
+
+	/**
+	 * @brief Valid path to the input file.
+	 */
+	string input_file;
+
+	/**
+	 * @brief Size of the input file (in bytes).
+	 */
+	uintmax_t inputfile_size;
+
+	/**
+	 * @brief Size of the input file's hashing unit (in bytes).
+	 */
+	uintmax_t block_size;
+
+	/**
+	 * @brief Size of a single read of the input file (in bytes).
+	 */
+	uintmax_t segment_size;
+
+	/**
+	 * @brief Names of the hashing algorithms.
+	 */
+	vector<string> hash_algorithms;
+
+	/**
+	 * @brief Hash engines, one per hashing algorithm.
+	 */
+	vector<unique_ptr<hashEngine>> engines;
+
+	/**
+	 * @brief Flag of the engines holding a partially hashed block
+	 * (previous computations have been interrupted).
+	 */
+	bool engines_dirty;
+
+	/**
+	 * @brief Input file opened for reading, kept between calls
+	 * (unused for the zstd seekable input).
+	 */
+	ifstream if_input;
+
+	/**
+	 * @brief Buffers of the double-buffered reading, allocated on the first use.
+	 */
+	array<vector<char>, 2> segments;
+
+	/**
+	 * @brief Optional limiter of the input file reading.
+	 */
+	shared_ptr<ioThrottle> io_throttle;
+
+	/**
+	 * @brief Reader of the uncompressed contents of the input file
+	 * in the zstd seekable format (nullptr - the input file is read as is).
+	 */
+	unique_ptr<zstdSeekableReader> zstd_input;
+
+	/**
+	 * @brief Flag of padding the last block with zeroes to the block size.
+	 * @see pad_last_block()
+	 */
+	bool zero_padding;
+
+	/**
+	 * @brief Path to the existing file the read data is copied to
+	 * (empty - no copying).
+	 *
+	 * @see copy_to()
+	 */
+	string copy_destination;
+
+	/**
+	 * @brief Source of zeroes for padding of the very last block.
+	 */
+	static const array<char, 64 << 10> zero_segment;
+
+	/**
+	 * @brief Size of the data fed to every hash engine before the next
+	 * data (in bytes), fits into L1/L2 cache.
+	 */
+	static constexpr uintmax_t hash_stride = 32 << 10;
+
+	/**
+	 * @brief Reads \a length bytes by a reader thread, which fills one of
+	 * \a segments while the other one is hashed.
+	 * @param length Quantity of bytes to read
+	 * @param read_segment Reader of the next segment into a buffer, returns its length
+	 * @param hash_segment Consumer of a read segment
+	 * @param stop Flag of the computations' interruption
+	 * @return status
+	 * @value true all data is hashed
+	 * @value false computations are interrupted
+	 * @throws runtime_error File system access errors, hashing library errors
+	 */
+	virtual bool stream_segments(uintmax_t length, const function<uintmax_t(char*)>& read_segment,
+								 const function<void(const char*, uintmax_t)>& hash_segment,
+								 const atomic<bool>& stop) noexcept(false);
+
+public:
+
+	/**
+	 * @brief Creates instance of the blockHasher class.
+	 * @param input Path to the input file
+	 * @param input_size Size of the input file (in bytes)
+	 * @param bs Size of the hashing unit (in bytes)
+	 * @param read_size Size of a single read (in bytes)
+	 * @param algorithms Names of the hashing algorithms
+	 * @param throttle Limiter of the input file reading (nullptr - no limits)
+	 * @param zstd_seekable Hash uncompressed contents of the input file
+	 * in the zstd seekable format (\a input_size is the uncompressed size)
+	 * @throws logic_error Unknown hashing algorithm, incorrect sizes,
+	 * the input file is not in the zstd seekable format
+	 * @throws runtime_error File system access errors
+	 * @exceptsafe strong
+	 */
+	blockHasher(const string& input, uintmax_t input_size, uintmax_t bs, uintmax_t read_size,
+				const vector<string>& algorithms,
+				shared_ptr<ioThrottle> throttle = nullptr,
+				bool zstd_seekable = false) noexcept(false);
+
+	/**
+	 * @brief Retargets the instance to another input file, keeping its
+	 * hash engines and buffers.
+	 * @param input Path to the input file
+	 * @param input_size Size of the input file (in bytes)
+	 * @throws logic_error The input file is not in the zstd seekable format
+	 * (for an instance reading zstd seekable files)
+	 * @throws runtime_error File system access errors
+	 */
+	void reset_input(const string& input, uintmax_t input_size) noexcept(false);
+
+	/**
+	 * @brief Sets whether the last block (partially) beyond the end of the input
+	 * file is padded with zeroes to the block size (default) or hashed up to the
+	 * end of the data. Padding is part of the signature format, while comparing
+	 * same-sized files doesn't need it.
+	 * @param padding Padding flag
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	void pad_last_block(bool padding) noexcept(true);
+
+	/**
+	 * @brief Sets the destination of the read data's copying: every read segment
+	 * is written to the \a destination at the segment's offset, by the reading
+	 * thread, while the previous segment is hashed.
+	 * @param destination Path to an existing file (empty - no copying)
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	void copy_to(const string& destination) noexcept(true);
+
+	/**
+	 * @brief Computes hash values of the blocks from \a begin_block up to
+	 * (not including) \a end_block, in order.
+	 * @param begin_block First block to proceed
+	 * @param end_block Block following the last block to proceed
+	 * @param on_block Receiver of a block's index and its hexadecimal
+	 * hash values (one per algorithm)
+	 * @param stop Flag of the computations' interruption
+	 * @return status
+	 * @value true all blocks are hashed
+	 * @value false computations are interrupted
+	 * @throws runtime_error File system access errors, hashing library errors
+	 */
+	bool hash_blocks(const uintmax_t begin_block, const uintmax_t end_block,
+					 const function<void(uintmax_t, const vector<string>&)>& on_block,
+					 const atomic<bool>& stop) noexcept(false);
+
+	/**
+	 * @brief Destructor of the blockHasher class.
+	 */
+	virtual ~blockHasher() = default;
+};
+
+
+#endif /* BLOCKHASHER_H_ */
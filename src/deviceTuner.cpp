@@ -0,0 +1,281 @@
+
+#include "deviceTuner.h"
+
+
+namespace {
+	// Amount of the input file read during the device calibration
+	constexpr uintmax_t calibration_read = 64 << 20;
+	// Amount of data hashed during the hashing calibration
+	constexpr uintmax_t calibration_hash = 16 << 20;
+	// Read size letting a single reader keep the device's queue deep
+	constexpr uintmax_t deep_read_size = 16 << 20;
+}
+
+
+deviceTuner::deviceTuner(const string& input, const vector<string>& algorithms) noexcept(false)
+{
+	if ((!filesystem::exists(input)) || (filesystem::is_directory(input)))
+		throw logic_error(std::string("File not found: ") + input);
+	this->input_file = input;
+	this->hash_algorithms = algorithms;
+	this->threads_num = 0;
+	this->read_size = 0;
+
+	string algorithms_list;
+	for (const auto& algorithm : algorithms)
+		algorithms_list += (algorithms_list.empty() ? "" : ",") + hashEngine::canonical_name(algorithm);
+
+#if defined(__linux__)
+	struct stat input_stat;
+	if (stat(input.c_str(), &input_stat) != 0)
+		throw runtime_error(input + " error on stat: " + strerror(errno));
+	this->device_key = to_string(major(input_stat.st_dev)) + ":" +
+					   to_string(minor(input_stat.st_dev)) + " " + algorithms_list;
+
+	const char* homedir = getenv("HOME");
+	if (homedir == nullptr)
+		homedir = getpwuid(getuid())->pw_dir;
+	this->cache_file = (homedir == nullptr) ? "" : string(homedir) + "/.cache/Signa/autotune";
+#else
+	this->device_key = algorithms_list;
+	this->cache_file = "";
+#endif
+}
+
+
+int deviceTuner::is_rotational(uint major, uint minor) const noexcept(true)
+{
+	error_code ec;
+	const filesystem::path device = filesystem::canonical("/sys/dev/block/" + to_string(major) +
+														  ":" + to_string(minor), ec);
+	if (ec)
+		return -1;
+
+	// Partitions keep the queue settings in their parent disk's directory
+	for (const auto& queue : {device / "queue", device.parent_path() / "queue"}) {
+		ifstream if_rotational(queue / "rotational");
+		int rotational;
+		if (if_rotational >> rotational)
+			return rotational ? 1 : 0;
+	}
+
+	return -1;
+}
+
+
+bool deviceTuner::drop_page_cache(uintmax_t length) const noexcept(true)
+{
+#if defined(__linux__)
+	const int input_fd = open(input_file.c_str(), O_RDONLY);
+	if (input_fd < 0)
+		return false;
+
+	// Dirty pages can't be evicted until they are written back
+	fdatasync(input_fd);
+	bool dropped = (posix_fadvise(input_fd, 0, static_cast<off_t>(length), POSIX_FADV_DONTNEED) == 0);
+
+	// Check that the pages are really gone: tmpfs and some network file
+	// systems keep them regardless of the advice
+	if (dropped) {
+		void* mapping = mmap(nullptr, length, PROT_READ, MAP_SHARED, input_fd, 0);
+		if (mapping != MAP_FAILED) {
+			const long page_size = sysconf(_SC_PAGESIZE);
+			vector<unsigned char> residency((length + page_size - 1) / page_size);
+			if (mincore(mapping, length, residency.data()) == 0) {
+				const auto resident = count_if(residency.begin(), residency.end(),
+											   [](unsigned char page) { return page & 1; });
+				dropped = (static_cast<size_t>(resident) * 16 <= residency.size());
+			}
+			munmap(mapping, length);
+		}
+	}
+
+	close(input_fd);
+	return dropped;
+#else
+	(void)length;
+	return false;
+#endif
+}
+
+
+double deviceTuner::read_throughput(bool& page_cached) const noexcept(false)
+{
+	const uintmax_t file_size = filesystem::file_size(input_file);
+	const uintmax_t to_read = min(file_size, calibration_read);
+	if (to_read < 2 * fileSignaturer::default_segment_size)
+		return 0;
+
+	page_cached = !drop_page_cache(to_read);
+
+	ifstream if_input(input_file, ios_base::in | ios_base::binary);
+	if_input.exceptions( ifstream::failbit | ifstream::badbit );
+	vector<char> segment(fileSignaturer::default_segment_size);
+
+	const auto start = chrono::steady_clock::now();
+	for (uintmax_t done = 0; done < to_read; done += segment.size())
+		if_input.read(segment.data(), min(static_cast<uintmax_t>(segment.size()), to_read - done));
+	const double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	return to_read / max(elapsed, 1e-6);
+}
+
+
+double deviceTuner::hash_throughput() const noexcept(false)
+{
+	vector<char> segment(fileSignaturer::default_segment_size);
+	for (size_t i = 0; i < segment.size(); ++i)
+		segment[i] = static_cast<char>(i * 2654435761u >> 24);
+
+	vector<unique_ptr<hashEngine>> engines;
+	for (const auto& algorithm : hash_algorithms)
+		engines.push_back(hashEngine::create(algorithm));
+
+	string cipherblock;
+	const auto start = chrono::steady_clock::now();
+	for (uintmax_t done = 0; done < calibration_hash; done += segment.size())
+		for (auto& engine : engines)
+			engine->process_bytes(segment.data(), segment.size());
+	for (auto& engine : engines)
+		engine->append_digest(cipherblock);
+	const double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	return calibration_hash / max(elapsed, 1e-6);
+}
+
+
+bool deviceTuner::load_cached() noexcept(true)
+{
+	if (cache_file.empty())
+		return false;
+
+	ifstream if_cache(cache_file);
+	string line;
+	while (getline(if_cache, line)) {
+		istringstream fields(line);
+		string key;
+		uint threads;
+		uintmax_t segment;
+		if ((getline(fields, key, '\t')) && (key == device_key) &&
+			(fields >> threads >> segment) && (threads > 0) && (segment > 0)) {
+			threads_num = threads;
+			read_size = segment;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+void deviceTuner::store_cached() const noexcept(true)
+{
+	if (cache_file.empty())
+		return;
+
+	try {
+		// Keep other devices' results, replace this device's ones
+		vector<string> lines;
+		ifstream if_cache(cache_file);
+		string line;
+		while (getline(if_cache, line))
+			if (line.compare(0, device_key.size() + 1, device_key + "\t") != 0)
+				lines.push_back(line);
+		if_cache.close();
+		lines.push_back(device_key + "\t" + to_string(threads_num) + "\t" + to_string(read_size));
+
+		filesystem::create_directories(filesystem::path(cache_file).parent_path());
+		const string tmp_cache = cache_file + fileSignaturer::tmpoutput_suffix;
+		ofstream of_cache;
+		of_cache.exceptions(ofstream::badbit | ofstream::failbit);
+		of_cache.open(tmp_cache, ios_base::out | ios_base::trunc);
+		for (const auto& entry : lines)
+			of_cache << entry << "\n";
+		of_cache.close();
+		filesystem::rename(tmp_cache, cache_file);
+	}
+	catch (exception& e) {
+		cerr << "Unable to cache autotuning results: " << e.what() << endl;
+	}
+}
+
+
+bool deviceTuner::tune(bool verbose) noexcept(true)
+{
+	if (load_cached()) {
+		cout << "Autotuning results for device " << device_key << " are taken from "
+			 << cache_file << endl;
+	} else {
+		try {
+			uint cores_num = thread::hardware_concurrency();
+			if (!cores_num)
+				cores_num = 1;
+
+			istringstream key(device_key);
+			uint major = 0, minor = 0;
+			char delim;
+			key >> major >> delim >> minor;
+			const int rotational = is_rotational(major, minor);
+			bool cache_results = true;
+
+			if (rotational == 1) {
+				// Parallel seeks thrash a spinning disk: one sequential reader
+				threads_num = 1;
+				read_size = deep_read_size;
+			} else {
+				bool page_cached = false;
+				const double read_speed = read_throughput(page_cached);
+				const double hash_speed = hash_throughput();
+				if (verbose)
+					cout << "Calibration: read " << static_cast<uintmax_t>(read_speed / (1 << 20))
+						 << " Mb/s, hashing " << static_cast<uintmax_t>(hash_speed / (1 << 20))
+						 << " Mb/s per thread" << endl;
+
+				if (read_speed <= 0) {
+					cout << "Input file is too small for autotuning, defaults are kept" << endl;
+					return false;
+				}
+
+				// Enough hashing threads to keep up with the device
+				threads_num = static_cast<uint>(min(static_cast<double>(cores_num),
+													max(1.0, ceil(read_speed / hash_speed))));
+				// The device is the bottleneck: deeper queue instead of more threads
+				read_size = (read_speed < hash_speed) ? deep_read_size : fileSignaturer::default_segment_size;
+
+				// Memory speed would be remembered as the device's one
+				if (page_cached)
+					cache_results = false;
+			}
+
+			cout << "Device " << device_key << " is "
+				 << ((rotational == 1) ? "rotational" : ((rotational == 0) ? "non-rotational" : "of unknown type"))
+				 << endl;
+			if (cache_results)
+				store_cached();
+			else
+				cout << "Input file is served by the page cache, autotuning results are not cached" << endl;
+		}
+		catch (exception& e) {
+			cerr << "Autotuning error: " << e.what() << endl;
+			threads_num = 0;
+			read_size = 0;
+			return false;
+		}
+	}
+
+	cout << "Autotuning: " << threads_num << " thread(s), " << (read_size >> 20)
+		 << " Mb reads" << endl;
+	return true;
+}
+
+
+uint deviceTuner::threads() const noexcept(true)
+{
+	return threads_num;
+}
+
+
+uintmax_t deviceTuner::segment_size() const noexcept(true)
+{
+	return read_size;
+}
@@ -0,0 +1,154 @@
+
+#ifndef DEVICETUNER_H_
+#define DEVICETUNER_H_
+
+#include <chrono>
+#include <sstream>
+#if defined(__linux__)
+	#include <sys/stat.h>
+	#include <sys/sysmacros.h>
+	#include <sys/mman.h>
+	#include <fcntl.h>
+	#include <pwd.h>
+	#include <unistd.h>
+#endif
+
+#include "fileSignaturer.h"
+
+
+/**
+ * @class deviceTuner
+ * @brief Chooses working threads' quantity and read size for fingerprinting
+ * of a file based on its storage device: rotational flag (sysfs) and short
+ * calibrations of the device's read throughput and the hashing throughput.
+ * Results are cached per device (and hashing algorithms), so later runs
+ * start instantly.
+ */
+class deviceTuner
+{
+protected:
+
+	/**
+	 * @brief Valid path to the probed file.
+	 */
+	string input_file;
+
+	/**
+	 * @brief Hashing algorithms the file will be fingerprinted with.
+	 */
+	vector<string> hash_algorithms;
+
+	/**
+	 * @brief Identifier of the device in the results' cache ("MAJOR:MINOR ALGORITHMS").
+	 */
+	string device_key;
+
+	/**
+	 * @brief Path to the results' cache (empty if unavailable).
+	 */
+	string cache_file;
+
+	/**
+	 * @brief Chosen quantity of working threads.
+	 */
+	uint threads_num;
+
+	/**
+	 * @brief Chosen size of a single read (in bytes).
+	 */
+	uintmax_t read_size;
+
+	/**
+	 * @brief Reads the device's rotational flag from sysfs.
+	 * @param major Major number of the device
+	 * @param minor Minor number of the device
+	 * @return 1 - rotational, 0 - non-rotational, -1 - unknown
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	virtual int is_rotational(uint major, uint minor) const noexcept(true);
+
+	/**
+	 * @brief Evicts the first \a length bytes of the probed file from the
+	 * page cache (Linux), so its reading measures the device, not the memory.
+	 * @param length Quantity of bytes to evict
+	 * @return status
+	 * @value true the data isn't cached anymore
+	 * @value false the data stays cached (e.g. tmpfs) or eviction is unsupported
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	virtual bool drop_page_cache(uintmax_t length) const noexcept(true);
+
+	/**
+	 * @brief Measures sequential read throughput of the probed file.
+	 * @param page_cached Set if the data has been served by the page cache,
+	 * so the throughput isn't the device's one
+	 * @return Bytes per second (0 if the file is too small to measure)
+	 * @throws runtime_error File system access errors
+	 */
+	virtual double read_throughput(bool& page_cached) const noexcept(false);
+
+	/**
+	 * @brief Measures throughput of one thread hashing with all of
+	 * the \a hash_algorithms.
+	 * @return Bytes per second
+	 * @throws runtime_error Hashing library errors
+	 */
+	virtual double hash_throughput() const noexcept(false);
+
+	/**
+	 * @brief Looks for the device's results in the cache.
+	 * @return status
+	 * @value true results found
+	 * @value false no results
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	virtual bool load_cached() noexcept(true);
+
+	/**
+	 * @brief Stores the device's results into the cache.
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	virtual void store_cached() const noexcept(true);
+
+public:
+
+	/**
+	 * @brief Creates instance of the deviceTuner class.
+	 * @param input Path to the file to be fingerprinted
+	 * @param algorithms Hashing algorithms of the fingerprinting
+	 * @throws logic_error Input file not found
+	 * @exceptsafe strong
+	 */
+	deviceTuner(const string& input, const vector<string>& algorithms) noexcept(false);
+
+	/**
+	 * @brief Chooses working threads' quantity and read size, either
+	 * from the cache or by probing the device.
+	 * @param verbose Level of additional information provided to the user
+	 * @return status
+	 * @value true success
+	 * @value false probing failed, defaults are kept
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	bool tune(bool verbose) noexcept(true);
+
+	/**
+	 * @brief Chosen quantity of working threads (0 - default policy).
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	uint threads() const noexcept(true);
+
+	/**
+	 * @brief Chosen size of a single read in bytes (0 - default size).
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	uintmax_t segment_size() const noexcept(true);
+
+	/**
+	 * @brief Destructor of the deviceTuner class.
+	 */
+	virtual ~deviceTuner() = default;
+};
+
+
+#endif /* DEVICETUNER_H_ */
@@ -0,0 +1,310 @@
+
+#include "duplicatesFinder.h"
+#include "fileSignaturer.h"
+
+
+duplicatesFinder::duplicatesFinder(const string& input, short bs, const vector<string>& algorithms,
+								   shared_ptr<ioThrottle> throttle) noexcept(false)
+{
+	if (!filesystem::is_directory(input))
+		throw logic_error(std::string("Directory not found: ") + input);
+	this->input_dir = input;
+
+	if ((bs <= 0) || (bs > 1024))
+		throw logic_error(std::string("Incorrect block size"));
+	this->block_size = static_cast<uintmax_t>(bs) << 20;
+
+	if (algorithms.empty())
+		throw logic_error(std::string("No hashing algorithm chosen"));
+	for (const auto& algorithm : algorithms) {
+		if (hashEngine::canonical_name(algorithm).empty())
+			throw logic_error("Unknown hashing algorithm: " + algorithm);
+		hash_algorithms.push_back(hashEngine::canonical_name(algorithm));
+	}
+
+	this->io_throttle = throttle;
+	this->computations_complete = false;
+	this->stop_computations.store(false, memory_order_release);
+	this->verbose_mode = false;
+
+	this->stage_items = 0;
+	this->next_item.store(0);
+	this->busy_workers = 0;
+	this->stage_number = 0;
+	this->pool_shutdown = false;
+
+	uint cores_num = thread::hardware_concurrency();
+	if (!cores_num)
+		cores_num = 1;
+	hashers.resize(cores_num);
+	for (uint i = 0; i < cores_num; ++i)
+		workers.emplace_back([this, i]() { worker_loop(i); });
+}
+
+
+void duplicatesFinder::worker_loop(uint worker) noexcept(true)
+{
+	if ((io_throttle) && (!io_throttle->apply_priority()))
+		sync_print("Unable to set idle I/O priority", true);
+
+	uint seen_stage = 0;
+	while (true) {
+		auto lock = unique_lock<mutex>(pool_mutex);
+		pool_notification.wait(lock, [this, seen_stage] {
+			return (pool_shutdown) || (stage_number != seen_stage); });
+		if (pool_shutdown)
+			return;
+		seen_stage = stage_number;
+		lock.unlock();
+
+		for (size_t item = next_item++; item < stage_items; item = next_item++)
+			stage_job(item, worker);
+
+		lock.lock();
+		if (--busy_workers == 0)
+			stage_notification.notify_all();
+	}
+}
+
+
+void duplicatesFinder::run_stage(size_t items, const function<void(size_t, uint)>& job) noexcept(true)
+{
+	auto lock = unique_lock<mutex>(pool_mutex);
+	stage_job = job;
+	stage_items = items;
+	next_item.store(0);
+	busy_workers = static_cast<uint>(workers.size());
+	++stage_number;
+	pool_notification.notify_all();
+
+	stage_notification.wait(lock, [this] { return busy_workers == 0; });
+}
+
+
+vector<vector<size_t>> duplicatesFinder::narrow(const vector<vector<size_t>>& groups,
+												const function<string(const file_entry&)>& key) const noexcept(false)
+{
+	vector<vector<size_t>> narrowed;
+
+	for (const auto& group : groups) {
+		map<string, vector<size_t>> subgroups;
+		for (const auto index : group)
+			if (!files[index].failed)
+				subgroups[key(files[index])].push_back(index);
+
+		for (auto& subgroup : subgroups)
+			if (subgroup.second.size() > 1)
+				narrowed.push_back(move(subgroup.second));
+	}
+
+	return narrowed;
+}
+
+
+void duplicatesFinder::probe_file(file_entry& file, uint worker) noexcept(true)
+{
+	if (!file.size)
+		return;
+
+	try {
+		auto& hasher = hashers.at(worker).probe;
+		if (!hasher) {
+			hasher = make_unique<blockHasher>(file.path, file.size, probe_size, probe_size,
+											  hash_algorithms, io_throttle);
+			hasher->pad_last_block(false);
+		} else
+			hasher->reset_input(file.path, file.size);
+
+		auto append_probe = [&file](uintmax_t, const vector<string>& cipherblocks) {
+			for (const auto& cipherblock : cipherblocks)
+				file.probe += cipherblock;
+		};
+
+		const uintmax_t last_block = (file.size - 1) / probe_size;
+		hasher->hash_blocks(0, 1, append_probe, stop_computations);
+		if (last_block > 0)
+			hasher->hash_blocks(last_block, last_block + 1, append_probe, stop_computations);
+	}
+	catch (exception& e) {
+		sync_print("Error during " + file.path + " probing: " + string(e.what()), true);
+		file.failed = true;
+	}
+}
+
+
+void duplicatesFinder::fingerprint_file(file_entry& file, uint worker) noexcept(true)
+{
+	// The probed blocks have covered the whole file
+	if (file.size <= 2 * probe_size)
+		return;
+
+	try {
+		auto& hasher = hashers.at(worker).full;
+		if (!hasher) {
+			hasher = make_unique<blockHasher>(file.path, file.size, block_size,
+											  fileSignaturer::default_segment_size,
+											  hash_algorithms, io_throttle);
+			// Files of a group are of the same size: padding carries no information
+			hasher->pad_last_block(false);
+		} else
+			hasher->reset_input(file.path, file.size);
+
+		// Blocks' hash values are digested instead of being kept
+		const auto digest = hashEngine::create(hash_algorithms.front());
+		auto digest_block = [&digest](uintmax_t, const vector<string>& cipherblocks) {
+			for (const auto& cipherblock : cipherblocks)
+				digest->process_bytes(cipherblock.data(), cipherblock.size());
+		};
+
+		const uintmax_t blocks_num = (file.size + block_size - 1) / block_size;
+		hasher->hash_blocks(0, blocks_num, digest_block, stop_computations);
+		digest->append_digest(file.fingerprint);
+	}
+	catch (exception& e) {
+		sync_print("Error during " + file.path + " fingerprinting: " + string(e.what()), true);
+		file.failed = true;
+	}
+}
+
+
+bool duplicatesFinder::compute_signature(bool verbose) noexcept(true)
+{
+	this->verbose_mode = verbose;
+
+	if (computations_complete) {
+		if (verbose_mode)
+			sync_print("Duplicates have been already found", false);
+		return true;
+	}
+
+	try {
+		sync_print("Duplicates search in progress...", false);
+
+		// Stage 0: list regular files of the directory tree
+		error_code ec;
+		for (auto it = filesystem::recursive_directory_iterator(input_dir,
+						filesystem::directory_options::skip_permission_denied, ec);
+			 it != filesystem::recursive_directory_iterator(); it.increment(ec)) {
+			if (ec)
+				break;
+			if (it->is_regular_file(ec) && (!it->is_symlink(ec)))
+				files.push_back(file_entry{it->path().string(), 0, "", "", false});
+		}
+		if (ec)
+			throw runtime_error("Listing " + input_dir + " error: " + ec.message());
+
+		// Stage 1: group by size
+		run_stage(files.size(), [this](size_t i, uint) {
+			error_code size_ec;
+			files[i].size = filesystem::file_size(files[i].path, size_ec);
+			if (size_ec) {
+				sync_print("Estimating size of " + files[i].path + " error: " + size_ec.message(), true);
+				files[i].failed = true;
+			}
+		});
+		vector<size_t> all_files(files.size());
+		for (size_t i = 0; i < files.size(); ++i)
+			all_files[i] = i;
+		auto candidates = narrow({all_files}, [](const file_entry& file) {
+			return to_string(file.size); });
+		auto count = [](const vector<vector<size_t>>& groups) {
+			size_t files_num = 0;
+			for (const auto& group : groups)
+				files_num += group.size();
+			return files_num;
+		};
+		sync_print(to_string(files.size()) + " file(s) found, " + to_string(count(candidates)) +
+				   " of them have same-sized companions", false);
+
+		// Stage 2: hash the first and the last small blocks
+		vector<size_t> stage_files;
+		for (const auto& group : candidates)
+			stage_files.insert(stage_files.end(), group.begin(), group.end());
+		run_stage(stage_files.size(), [this, &stage_files](size_t i, uint worker) {
+			probe_file(files[stage_files[i]], worker); });
+		candidates = narrow(candidates, [](const file_entry& file) { return file.probe; });
+		sync_print(to_string(count(candidates)) + " file(s) remain after probing", false);
+
+		// Stage 3: full fingerprints of the still colliding files
+		stage_files.clear();
+		for (const auto& group : candidates)
+			stage_files.insert(stage_files.end(), group.begin(), group.end());
+		run_stage(stage_files.size(), [this, &stage_files](size_t i, uint worker) {
+			fingerprint_file(files[stage_files[i]], worker);
+			if (verbose_mode)
+				sync_print(files[stage_files[i]].path + " fingerprinted", false);
+		});
+		duplicate_groups = narrow(candidates, [](const file_entry& file) { return file.fingerprint; });
+	}
+	catch (exception& e) {
+		sync_print("Error during duplicates search: " + string(e.what()), true);
+		return false;
+	}
+
+	computations_complete = true;
+	sync_print(to_string(duplicate_groups.size()) + " group(s) of identical files found", false);
+	return true;
+}
+
+
+bool duplicatesFinder::save_signature(const string& output) const noexcept(true)
+{
+	if (!computations_complete) {
+		sync_print("Nothing to save. Duplicates search is not completed", true);
+		return false;
+	}
+
+	const string tmp_output = output + fileSignaturer::tmpoutput_suffix;
+	error_code ec;
+
+	try {
+		ofstream of_whole;
+		of_whole.exceptions(ofstream::badbit | ofstream::failbit);
+		of_whole.open(tmp_output, ios_base::out | ios_base::trunc);
+		for (const auto& group : duplicate_groups) {
+			of_whole << files[group.front()].size << " " << group.size() << "\n";
+			for (const auto index : group)
+				of_whole << files[index].path << "\n";
+			of_whole << "\n";
+		}
+		of_whole.close();
+
+		filesystem::rename(tmp_output, output, ec);
+		if (ec)
+			throw runtime_error(output +
+					" unsuccessful overwrite attempt of an existing file: " + ec.message());
+	}
+	catch (exception& e) {
+		sync_print("Saving error: " + string(e.what()), true);
+		filesystem::remove(tmp_output, ec);
+		return false;
+	}
+
+	sync_print("Duplicates have been saved", false);
+	return true;
+}
+
+
+void duplicatesFinder::sync_print(const string& str, bool is_errmsg) const noexcept(true)
+{
+	print_mutex.lock();
+	if (is_errmsg)
+		cerr << str << endl;
+	else
+		cout << str << endl;
+	print_mutex.unlock();
+}
+
+
+duplicatesFinder::~duplicatesFinder()
+{
+	{
+		auto lock = unique_lock<mutex>(pool_mutex);
+		pool_shutdown = true;
+	}
+	pool_notification.notify_all();
+
+	for (auto& worker : workers)
+		if (worker.joinable())
+			worker.join();
+}
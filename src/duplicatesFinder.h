@@ -0,0 +1,267 @@
+
+#ifndef DUPLICATESFINDER_H_
+#define DUPLICATESFINDER_H_
+
+#include <iostream>
+#include <filesystem>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <map>
+
+#include "blockHasher.h"
+#include "signaturer.h"
+
+
+/**
+ * @class duplicatesFinder
+ * @brief Finds groups of identical files in a directory tree by progressive
+ * fingerprinting: files are grouped by size first, then only the first and
+ * the last small blocks of the same-sized files are hashed, and only files
+ * which still collide are fully fingerprinted. Every stage runs on the same
+ * pool of working threads, every working thread reuses its own hashers
+ * for all of the files.
+ */
+class duplicatesFinder : public signaturer
+{
+protected:
+
+	/**
+	 * @brief Size of the first and the last blocks hashed to rule out
+	 * same-sized files (in bytes).
+	 */
+	static constexpr uintmax_t probe_size = 4 << 10;
+
+	/**
+	 * @brief Found file and its fingerprints.
+	 */
+	struct file_entry
+	{
+		string path;
+		uintmax_t size;
+		string probe;
+		string fingerprint;
+		bool failed;
+	};
+
+	/**
+	 * @brief Hashers of a working thread, created on the first use.
+	 */
+	struct worker_hashers
+	{
+		unique_ptr<blockHasher> probe;
+		unique_ptr<blockHasher> full;
+	};
+
+	/**
+	 * @brief Valid path to user provided directory.
+	 */
+	string input_dir;
+
+	/**
+	 * @brief Size of the hashing unit of the full fingerprinting (in bytes).
+	 */
+	uintmax_t block_size;
+
+	/**
+	 * @brief Names of the hashing algorithms.
+	 */
+	vector<string> hash_algorithms;
+
+	/**
+	 * @brief Optional limiter of the files reading shared by working threads.
+	 */
+	shared_ptr<ioThrottle> io_throttle;
+
+	/**
+	 * @brief Regular files of the directory tree.
+	 */
+	vector<file_entry> files;
+
+	/**
+	 * @brief Groups of identical files (indexes in \a files).
+	 */
+	vector<vector<size_t>> duplicate_groups;
+
+	/**
+	 * @brief Flag of successfully ending of the search.
+	 */
+	bool computations_complete;
+
+	/**
+	 * @brief Never raised: files' errors exclude the files from the search
+	 * instead of interrupting it.
+	 */
+	atomic<bool> stop_computations;
+
+	/**
+	 * @brief Working threads of the pool, shared by all of the stages.
+	 */
+	vector<thread> workers;
+
+	/**
+	 * @brief Hashers of the working threads (indexed by the working thread's number).
+	 */
+	vector<worker_hashers> hashers;
+
+	/**
+	 * @brief Guard of the pool's state.
+	 */
+	mutex pool_mutex;
+
+	/**
+	 * @brief Notification (from leader to working threads) of a new stage
+	 * or of the pool shutdown.
+	 */
+	condition_variable pool_notification;
+
+	/**
+	 * @brief Notification (from working threads to leader) of the stage end.
+	 */
+	condition_variable stage_notification;
+
+	/**
+	 * @brief Job of the current stage, applied to every item's index
+	 * (and the number of the working thread).
+	 */
+	function<void(size_t, uint)> stage_job;
+
+	/**
+	 * @brief Quantity of items of the current stage.
+	 */
+	size_t stage_items;
+
+	/**
+	 * @brief Index of the next item of the current stage to proceed.
+	 */
+	atomic<size_t> next_item;
+
+	/**
+	 * @brief Quantity of working threads busy with the current stage.
+	 */
+	uint busy_workers;
+
+	/**
+	 * @brief Sequence number of the current stage.
+	 */
+	uint stage_number;
+
+	/**
+	 * @brief Flag of the pool shutdown.
+	 */
+	bool pool_shutdown;
+
+	/**
+	* @brief Given level of additional information provided to user.
+	*/
+	bool verbose_mode;
+
+	/**
+	 * @brief Guard of console printing which shared by the leader and working threads.
+	 */
+	mutable mutex print_mutex;
+
+	/**
+	 * @brief Working thread method: proceeds items of every stage.
+	 * @param worker Number of the working thread
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	virtual void worker_loop(uint worker) noexcept(true);
+
+	/**
+	 * @brief Applies \a job to items from 0 up to \a items using all of the
+	 * working threads, hangs until all of the items are proceeded.
+	 * Leader thread method.
+	 * @param items Quantity of items
+	 * @param job Item's processing (item's index, working thread's number),
+	 * shall not throw exceptions
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	virtual void run_stage(size_t items, const function<void(size_t, uint)>& job) noexcept(true);
+
+	/**
+	 * @brief Splits candidate groups by a files' key, drops groups of
+	 * a single file and failed files.
+	 * @param groups Candidate groups
+	 * @param key File's key
+	 * @return Narrowed candidate groups
+	 * @throws bad_alloc
+	 */
+	virtual vector<vector<size_t>> narrow(const vector<vector<size_t>>& groups,
+										  const function<string(const file_entry&)>& key) const noexcept(false);
+
+	/**
+	 * @brief Hashes the first and the last \a probe_size blocks of a file,
+	 * reading them synchronously through one opened stream.
+	 * @param file Found file
+	 * @param worker Number of the working thread
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	virtual void probe_file(file_entry& file, uint worker) noexcept(true);
+
+	/**
+	 * @brief Hashes all of the \a block_size blocks of a file and digests
+	 * the blocks' hash values into the file's fingerprint.
+	 * @param file Found file
+	 * @param worker Number of the working thread
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	virtual void fingerprint_file(file_entry& file, uint worker) noexcept(true);
+
+	/**
+	 * @brief Synchronized console printing method
+	 * for leader thread and working threads.
+	 * @param str Message for console printing
+	 * @param is_errmsg Message error status
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	virtual void sync_print(const string& str, bool is_errmsg) const noexcept(true);
+
+public:
+
+	/**
+	 * @brief Creates instance of the duplicatesFinder class,
+	 * starts working threads of the pool.
+	 * @param input Path to the directory
+	 * @param bs Block size of the full fingerprinting (in Mb, up to 1Gb, default: 1)
+	 * @param algorithms Names of the hashing algorithms
+	 * @param throttle Limiter of the files reading (nullptr - no limits)
+	 * @throws logic_error Directory not found, incorrect parameters
+	 * @exceptsafe strong
+	 */
+	duplicatesFinder(const string& input, short bs, const vector<string>& algorithms,
+					 shared_ptr<ioThrottle> throttle = nullptr) noexcept(false);
+
+	/**
+	 * @brief Finds groups of identical files.
+	 * Leader thread method.
+	 * @param verbose Level of additional information provided to the user
+	 * @return status
+	 * @value true success
+	 * @value false fail
+	 * @exceptsafe Shall not throw exceptions.
+	 *
+	 * @see probe_file(), fingerprint_file()
+	 */
+	bool compute_signature(bool verbose) noexcept(true);
+
+	/**
+	 * @brief Saves groups of identical files to the \a output file: every group
+	 * is a line "SIZE FILES_QUANTITY" followed by the files' paths and an empty line.
+	 * The \a output file is replaced atomically.
+	 * @param output Path to the output result file
+	 * @return status
+	 * @value true success
+	 * @value false fail
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	bool save_signature(const string& output) const noexcept(true);
+
+	/**
+	 * @brief Stops working threads of the pool.
+	 */
+	~duplicatesFinder();
+};
+
+
+#endif /* DUPLICATESFINDER_H_ */
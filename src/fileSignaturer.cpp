@@ -3,7 +3,11 @@
 #include "fileSignaturer.h"
 
 
-fileSignaturer::fileSignaturer(const string& input, short bs) noexcept(false)
+fileSignaturer::fileSignaturer(const string& input, short bs,
+							   uintmax_t first_block, uintmax_t last_block,
+							   const vector<string>& algorithms,
+							   uint threads_limit, uintmax_t read_size,
+							   bool zstd_input) noexcept(false)
 {
 	///////////////////////////////////////////////////////////////////////////////////
 	// Collect setup information (about target file and target system)
@@ -15,30 +19,69 @@ fileSignaturer::fileSignaturer(const string& input, short bs) noexcept(false)
 	this->input_file = input;
 
 	// Get input file's properties
-	error_code ec;
-	this->inputfile_size = filesystem::file_size(input_file, ec);
-	if (ec)
-		throw runtime_error("Estimating size of " + input_file + " error: " + ec.message());
-	else
-		sync_print("Input file size = " + to_string(inputfile_size) + " byte(s)", false);
+	this->zstd_seekable = zstd_input;
+	if (zstd_seekable) {
+		this->inputfile_size = zstdSeekableReader(input_file).size();
+		sync_print("Input file uncompressed size = " + to_string(inputfile_size) + " byte(s)", false);
+	} else {
+		error_code ec;
+		this->inputfile_size = filesystem::file_size(input_file, ec);
+		if (ec)
+			throw runtime_error("Estimating size of " + input_file + " error: " + ec.message());
+		else
+			sync_print("Input file size = " + to_string(inputfile_size) + " byte(s)", false);
+	}
 
 	// Examine chosen block size
 	if ((bs == 0) || (bs > 1024))
 		throw logic_error(std::string("Incorrect block size"));
 	this->block_size = bs << 20;
+	this->segment_size = read_size ? read_size : default_segment_size;
+
+	// Examine chosen hashing algorithms
+	if (algorithms.empty())
+		throw logic_error(std::string("No hashing algorithm chosen"));
+	for (const auto& algorithm : algorithms) {
+		const string name = hashEngine::canonical_name(algorithm);
+		if (name.empty())
+			throw logic_error("Unknown hashing algorithm: " + algorithm);
+		if (find(hash_algorithms.begin(), hash_algorithms.end(), name) != hash_algorithms.end())
+			throw logic_error("Duplicated hashing algorithm: " + algorithm);
+		hash_algorithms.push_back(name);
+	}
 
 	// Quantity of blocks in input file. Equivalently,
-	// quantity of hash values in output file
-	const uintmax_t inputblocks_num = (inputfile_size > 0) ?
+	// quantity of hash values in the whole signature
+	this->blocks_total = (inputfile_size > 0) ?
 			static_cast<uintmax_t>(ceil(inputfile_size / static_cast<double>(block_size))) : 1;
 
+	// Examine chosen blocks' range (the whole file by default)
+	this->range_given = (first_block != 0) || (last_block != 0);
+	if (!range_given)
+		last_block = blocks_total;
+	if ((first_block >= last_block) || (last_block > blocks_total))
+		throw logic_error("Incorrect blocks range " + to_string(first_block) + ":" +
+						  to_string(last_block) + ", input file consists of " +
+						  to_string(blocks_total) + " block(s)");
+	this->range_begin = first_block;
+	this->range_end = last_block;
+
+	// Quantity of blocks to proceed. Equivalently,
+	// quantity of hash values in output file
+	const uintmax_t inputblocks_num = range_end - range_begin;
+	if (is_partial())
+		sync_print("Blocks " + to_string(range_begin) + " to " + to_string(range_end) +
+				   " of " + to_string(blocks_total) + " will be proceeded", false);
+
 	// RAM or Disk Space
-	choose_cache_location(inputblocks_num);
+	choose_cache_location(inputblocks_num * hash_algorithms.size());
 
 	// Check quantity of CPUs
 	uint cores_num = thread::hardware_concurrency();
 	if ( (!cores_num) || (!inputfile_size))
 		cores_num = 1;
+	if ((threads_limit > 0) && (threads_limit < cores_num))
+		cores_num = threads_limit;
 
 	// Set quantity of work threads
 	uintmax_t threads_num = (inputblocks_num > cores_num) ? cores_num : inputblocks_num;
@@ -51,52 +94,57 @@ fileSignaturer::fileSignaturer(const string& input, short bs) noexcept(false)
 	// Group inputfile's blocks to optimal chunks
 	uintmax_t chunk_size_common = inputblocks_num / threads_num;
 	uintmax_t chunk_size_remainder = inputblocks_num % threads_num;
-	uintmax_t left_block = 0;
-	uintmax_t right_block = 0;
+	uintmax_t left_block = range_begin;
+	uintmax_t right_block = range_begin;
 
 	// Calculate chunks' details for every work thread
 	struct chunk_settings
 	{
-		string hash_storage;
+		vector<string> hash_storage;
 		uintmax_t left_boundary;
 		uintmax_t right_boundary;
 	};
 	map<uint, chunk_settings> threadids_args;
 
 	for (uint i = 0; i < threads_num; ++i) {
-		string cache = "";
+		vector<string> caches(hash_algorithms.size(), "");
 		if (cachestorage_available) {
-			// Set unique name for work thread's exclusive cache file
+			// Set unique name for work thread's exclusive cache file (one per algorithm)
 			mt19937 generator{random_device{}()};
 			uniform_int_distribution<int> discrete_uniform{'0', '9'};
 			string rand_cachefilename(32, '\0');
 			for( auto& elem : rand_cachefilename )
 				elem = discrete_uniform(generator);
-			cache = cache_dir + "/" + to_string(i) + "_" + rand_cachefilename + ".cache";
+			for (size_t alg = 0; alg < hash_algorithms.size(); ++alg)
+				caches[alg] = cache_dir + "/" + to_string(i) + "_" + hash_algorithms[alg] + "_" +
+							  rand_cachefilename + ".cache";
 		}
 
 		right_block = left_block + chunk_size_common + static_cast<bool>(chunk_size_remainder);
 
-		threadids_args.emplace(i, chunk_settings{cache, left_block, right_block});
+		threadids_args.emplace(i, chunk_settings{caches, left_block, right_block});
 
 		left_block = right_block;
 		if (chunk_size_remainder > 0)
 			chunk_size_remainder--;
 	}
-	if (right_block != inputblocks_num)
+	if (right_block != range_end)
 		throw logic_error("Internal error: incorrect input file splitting");
 
 	// Delay (suspend) computations of work threads while the leader thread is not fully ready
 	auto lock = unique_lock<mutex>(chunkthreads_mutex);
 	this->computations_complete = false;
+	this->stop_computations.store(false, memory_order_release);
 	this->leaderthread_ready = false;
 
 	// Assign chunks to work threads and start threads (in "suspended state")
+	// (chunk's settings are copied: threadids_args doesn't outlive the constructor)
 	for ( const auto& thread_settings : threadids_args)
-		caches_threads.emplace_back(pair<string, thread>
-				(thread_settings.second.hash_storage, thread{[&]() {process_filechunk(thread_settings.first,
-																					thread_settings.second.left_boundary,
-																					thread_settings.second.right_boundary);}}));
+		caches_threads.emplace_back(pair<vector<string>, thread>
+				(thread_settings.second.hash_storage, thread{[this, thread_settings]() {
+																process_filechunk(thread_settings.first,
+																				  thread_settings.second.left_boundary,
+																				  thread_settings.second.right_boundary);}}));
 }
 
 
@@ -164,75 +212,44 @@ void fileSignaturer::process_filechunk(const uint thread_id, const uintmax_t beg
 		return;
 
 	// Calculate boundary bytes
-	uintmax_t start_pos = begin_block * block_size + thread_id;
-	uintmax_t finish_pos = end_block * block_size + thread_id;
+	uintmax_t start_pos = begin_block * block_size;
+	uintmax_t finish_pos = end_block * block_size;
 	sync_print(to_string(thread_id) + ": computations for " + input_file +
 			   " from " + to_string(start_pos) + " byte to " +
 			   to_string(finish_pos) + " byte in process", false);
 
 	try {
 		// Check thread's cache accessibility
-		if ((cachestorage_available) && (filesystem::exists(caches_threads.at(thread_id).first)))
-			throw runtime_error(caches_threads.at(thread_id).first +
-					            " already exists. Unable to proceed");
-
-		// Read thread's inputfile chunk block by block
-		std::vector<char> plainblock(block_size,0);
-		string cipherblock;
-		ifstream if_input(input_file, ios_base::in | ios_base::binary);
-		if_input.exceptions( ifstream::failbit | ifstream::badbit );
-		if (!if_input.is_open())
-			throw runtime_error(input_file + " error on open");
-
-		for (uintmax_t i_block = begin_block; i_block < end_block; ++i_block) {
-			if (stop_computations.load(memory_order_acquire)) {
-				sync_print(to_string(thread_id) + ": computations for " + input_file +
-						   " from " + to_string(start_pos) + " byte to " +
-						   to_string(finish_pos) + " byte interrupted", true);
-				return;
-			}
-
-			if (if_input.eof())
-				throw logic_error(input_file + " error on read (unexpected eof)");
-
-			if_input.seekg(i_block * block_size + thread_id);
+		if (cachestorage_available)
+			for (const auto& cache : caches_threads.at(thread_id).first)
+				if (filesystem::exists(cache))
+					throw runtime_error(cache + " already exists. Unable to proceed");
 
-			if ((thread_id == caches_threads.size() - 1) && (i_block == end_block - 1))
-				if_input.exceptions( ifstream::goodbit );
-			if_input.read(plainblock.data(), block_size);
+		if ((io_throttle) && (!io_throttle->apply_priority()))
+			sync_print(to_string(thread_id) + ": unable to set idle I/O priority", true);
 
-			// Padding the very last block with zeros to the block size
-			if (static_cast<uintmax_t>(if_input.gcount()) != block_size)
-				fill(plainblock.begin() + if_input.gcount(),  plainblock.end(), 0);
+		// Read thread's inputfile chunk by fixed-size segments,
+		// so memory consumption doesn't depend on the block size
+		blockHasher hasher(input_file, inputfile_size, block_size, segment_size,
+						   hash_algorithms, io_throttle, zstd_seekable);
+		hasher.copy_to(copy_destination);
 
-			// Compute hash for current block using MD5 algorithm
-			md5 boost_md5;
-			boost_md5.process_bytes(plainblock.data(), block_size);
-			md5::digest_type fingerprint;
-			boost_md5.get_digest(fingerprint);
-			const auto byte_fingerprint = reinterpret_cast<const char*>(&fingerprint);
-			cipherblock.clear();
-			hex(byte_fingerprint, byte_fingerprint+sizeof(md5::digest_type), back_inserter(cipherblock));
-
-			// Save block's hash value into cache
-			if (cachestorage_available) {
-				ofstream cachefile;
-				cachefile.exceptions( ifstream::failbit | ifstream::badbit );
-				cachefile.open(caches_threads.at(thread_id).first, ios_base::app);
-				if (!cachefile.is_open())
-					throw runtime_error(caches_threads.at(thread_id).first + " error on open");
-				cachefile << cipherblock;
-				cachefile.close();
-			}
-			else {
-				caches_threads.at(thread_id).first.append(cipherblock);
-			}
+		// Save block's hash values into caches
+		auto store_block = [this, thread_id](uintmax_t i_block, const vector<string>& cipherblocks) {
+			for (size_t alg = 0; alg < cipherblocks.size(); ++alg)
+				store_hash(thread_id, alg, cipherblocks[alg]);
 
 			if (verbose_mode)
 				sync_print("Hash for block " + to_string(i_block) +
 						   " calculated and stored in cache", false);
+		};
+
+		if (!hasher.hash_blocks(begin_block, end_block, store_block, stop_computations)) {
+			sync_print(to_string(thread_id) + ": computations for " + input_file +
+					   " from " + to_string(start_pos) + " byte to " +
+					   to_string(finish_pos) + " byte interrupted", true);
+			return;
 		}
-		if_input.close();
 	}
 	catch (exception& e) {
 		sync_print("Error during " + input_file +
@@ -248,6 +265,25 @@ void fileSignaturer::process_filechunk(const uint thread_id, const uintmax_t beg
 }
 
 
+void fileSignaturer::store_hash(const uint thread_id, const size_t alg,
+								const string& cipherblock) noexcept(false)
+{
+	string& cache = caches_threads.at(thread_id).first.at(alg);
+	if (cachestorage_available) {
+		ofstream cachefile;
+		cachefile.exceptions( ifstream::failbit | ifstream::badbit );
+		cachefile.open(cache, ios_base::app);
+		if (!cachefile.is_open())
+			throw runtime_error(cache + " error on open");
+		cachefile << cipherblock;
+		cachefile.close();
+	}
+	else {
+		cache.append(cipherblock);
+	}
+}
+
+
 void fileSignaturer::wait_for_workers() noexcept(true)
 {
 	if (!caches_threads.size())
@@ -275,8 +311,15 @@ bool fileSignaturer::compute_signature(bool verbose) noexcept(true)
 		if (stop_computations.load(memory_order_acquire)) {
 			sync_print("Signature computations failed", true);
 			return false;
-		} else
-			computations_complete = true;
+		}
+
+		// The copy is durable before the source may be discarded
+		if ((!copy_destination.empty()) && (!sync_copy())) {
+			sync_print("Signature computations failed", true);
+			return false;
+		}
+
+		computations_complete = true;
 	} else if (verbose_mode)
 		sync_print("Signature has been already calculated", false);
 
@@ -286,47 +329,66 @@ bool fileSignaturer::compute_signature(bool verbose) noexcept(true)
 }
 
 
-bool fileSignaturer::assemble_output(const string& output_file) const noexcept(true)
+void fileSignaturer::set_io_throttle(shared_ptr<ioThrottle> throttle) noexcept(true)
+{
+	this->io_throttle = throttle;
+}
+
+
+bool fileSignaturer::assemble_output(const string& output_file, const size_t alg) const noexcept(true)
 {
 	bool ret_val = true;
+	// Signature is assembled aside and then renamed over the output file,
+	// so readers never observe a partially written signature
+	const string tmp_output = output_file + tmpoutput_suffix;
+	error_code ec;
 
 	try {
 		if (caches_threads.size() > 0) {
-			error_code ec;
-			filesystem::remove(output_file, ec);
+			filesystem::remove(tmp_output, ec);
 			if (ec)
-				throw runtime_error(output_file +
+				throw runtime_error(tmp_output +
 						" unsuccessful overwrite attempt of an existing file: " + ec.message());
 			ofstream of_whole;
 			of_whole.exceptions(ofstream::badbit | ofstream::failbit);
 			if (cachestorage_available) {
 				// Assemble cache files
-				of_whole.open(output_file, ios_base::out | ios_base::binary | ios_base::app);
+				of_whole.open(tmp_output, ios_base::out | ios_base::binary | ios_base::app);
 				if (!of_whole.is_open())
-					throw runtime_error(output_file + " error on open");
+					throw runtime_error(tmp_output + " error on open");
+				if (is_partial())
+					of_whole << partial_header(alg);
 				for ( const auto& cachethread : caches_threads ) {
-					ifstream if_chunk(cachethread.first, ios_base::in | ios_base::binary);
+					ifstream if_chunk(cachethread.first.at(alg), ios_base::in | ios_base::binary);
 					if_chunk.exceptions(ofstream::badbit | ofstream::failbit);
 					if (!if_chunk.is_open())
-							throw runtime_error(cachethread.first + " error on open");
+							throw runtime_error(cachethread.first.at(alg) + " error on open");
 					of_whole.seekp(0, ios_base::end);
 					of_whole << if_chunk.rdbuf();
 					if_chunk.close();
 				}
 			} else {
 				// Assemble RAM-based caches
-				of_whole.open(output_file, ios_base::out | ios_base::app);
+				of_whole.open(tmp_output, ios_base::out | ios_base::app);
 				if (!of_whole.is_open())
-					throw runtime_error(output_file + " error on open");
+					throw runtime_error(tmp_output + " error on open");
+				if (is_partial())
+					of_whole << partial_header(alg);
 				for ( const auto& cachethread : caches_threads )
-					of_whole << cachethread.first;
+					of_whole << cachethread.first.at(alg);
 			}
 			of_whole.close();
+
+			filesystem::rename(tmp_output, output_file, ec);
+			if (ec)
+				throw runtime_error(output_file +
+						" unsuccessful overwrite attempt of an existing file: " + ec.message());
 		} else
 			throw logic_error(string("Empty cache, nothing to assemble"));
 	}
 	catch(exception& e) {
 		sync_print("Assembling error: " + string(e.what()), true);
+		filesystem::remove(tmp_output, ec);
 		ret_val = false;
 	}
 
@@ -334,6 +396,20 @@ bool fileSignaturer::assemble_output(const string& output_file) const noexcept(t
 }
 
 
+bool fileSignaturer::is_partial() const noexcept(true)
+{
+	return range_given;
+}
+
+
+string fileSignaturer::partial_header(const size_t alg) const noexcept(false)
+{
+	return string(partialheader_magic) + " " + hash_algorithms.at(alg) + " " + to_string(inputfile_size) +
+		   " " + to_string(block_size) + " " + to_string(range_begin) + " " +
+		   to_string(range_end) + "\n";
+}
+
+
 bool fileSignaturer::save_signature(const string& output) const noexcept(true)
 {
 	if (stop_computations.load(memory_order_acquire)) {
@@ -357,13 +433,156 @@ bool fileSignaturer::save_signature(const string& output) const noexcept(true)
 		return false;
 	}
 
-	if (assemble_output(output)) {
-		sync_print("Signature has been saved", false);
-		return true;
+	// Several algorithms: every one gets its own signature OUTPUT.ALGORITHM
+	bool ret_val = true;
+	for (size_t alg = 0; alg < hash_algorithms.size(); ++alg) {
+		const string alg_output = output_path(output, alg);
+
+		if (assemble_output(alg_output, alg))
+			sync_print(hash_algorithms[alg] + " signature has been saved to " + alg_output, false);
+		else
+			ret_val = false;
 	}
 
-	sync_print(string("Errors during signature saving"), false);
-	return false;
+	if (!ret_val)
+		sync_print(string("Errors during signature saving"), false);
+	return ret_val;
+}
+
+
+string fileSignaturer::output_path(const string& output, const size_t alg) const noexcept(false)
+{
+	if (hash_algorithms.size() == 1)
+		return output;
+
+	string extension = hash_algorithms.at(alg);
+	transform(extension.begin(), extension.end(), extension.begin(),
+			  [](unsigned char c) { return static_cast<char>(tolower(c)); });
+	return output + "." + extension;
+}
+
+
+void fileSignaturer::set_copy_destination(const string& destination) noexcept(false)
+{
+	if (!copy_destination.empty())
+		throw logic_error("Copy destination is already set: " + copy_destination);
+
+	error_code ec;
+	if ((filesystem::exists(destination, ec)) &&
+		(filesystem::equivalent(destination, input_file, ec)))
+		throw logic_error(destination + " is the input file itself");
+
+	// Working threads write their chunks into the existing file of the final size.
+	// Contents outside of the blocks' range are kept (other partial runs' copies)
+	if (!filesystem::exists(destination, ec)) {
+		ofstream of_copy(destination, ios_base::out | ios_base::binary);
+		if (!of_copy.is_open())
+			throw runtime_error(destination + " error on create");
+		this->copy_created = true;
+	}
+	filesystem::resize_file(destination, inputfile_size, ec);
+	if (ec)
+		throw runtime_error(destination + " error on resize: " + ec.message());
+
+	this->copy_destination = destination;
+	sync_print("Input file will be copied to " + copy_destination, false);
+}
+
+
+bool fileSignaturer::sync_copy() const noexcept(true)
+{
+#if defined(__linux__)
+	const int copy_fd = open(copy_destination.c_str(), O_RDONLY);
+	if (copy_fd < 0) {
+		sync_print(copy_destination + " error on open: " + strerror(errno), true);
+		return false;
+	}
+	const bool synced = (fsync(copy_fd) == 0);
+	if (!synced)
+		sync_print(copy_destination + " error on sync: " + strerror(errno), true);
+	close(copy_fd);
+	if ((!synced) || (!copy_created))
+		return synced;
+
+	// New directory entry of the copy isn't durable until its directory is synced
+	string copy_directory = filesystem::path(copy_destination).parent_path().string();
+	if (copy_directory.empty())
+		copy_directory = ".";
+	const int directory_fd = open(copy_directory.c_str(), O_RDONLY | O_DIRECTORY);
+	if (directory_fd < 0) {
+		sync_print(copy_directory + " error on open: " + strerror(errno), true);
+		return false;
+	}
+	const bool directory_synced = (fsync(directory_fd) == 0);
+	if (!directory_synced)
+		sync_print(copy_directory + " error on sync: " + strerror(errno), true);
+	close(directory_fd);
+	return directory_synced;
+#else
+	return true;
+#endif
+}
+
+
+bool fileSignaturer::verify_copy(const string& output, bool verbose) noexcept(true)
+{
+	if ((copy_destination.empty()) || (!computations_complete)) {
+		sync_print("Nothing to verify. Copy has not been made", true);
+		return false;
+	}
+
+	sync_print("Copy verification...", false);
+
+	const string verify_output = output + ".copy-verify";
+	bool ret_val = true;
+
+	try {
+		#ifdef __linux__
+			// Make the read-back hit the device instead of the just written
+			// page cache (the copy has been synced by compute_signature())
+			const int copy_fd = open(copy_destination.c_str(), O_RDONLY);
+			if (copy_fd >= 0) {
+				posix_fadvise(copy_fd, 0, 0, POSIX_FADV_DONTNEED);
+				close(copy_fd);
+			}
+		#endif
+
+		fileSignaturer copy_signer(copy_destination, static_cast<short>(block_size >> 20),
+								   range_given ? range_begin : 0, range_given ? range_end : 0, hash_algorithms,
+								   static_cast<uint>(caches_threads.size()), segment_size);
+		copy_signer.set_io_throttle(io_throttle);
+		if ((!copy_signer.compute_signature(verbose)) || (!copy_signer.save_signature(verify_output)))
+			throw runtime_error("unable to fingerprint " + copy_destination);
+
+		for (size_t alg = 0; alg < hash_algorithms.size(); ++alg) {
+			ifstream if_source(output_path(output, alg), ios_base::in | ios_base::binary);
+			ifstream if_copy(output_path(verify_output, alg), ios_base::in | ios_base::binary);
+			if ((!if_source.is_open()) || (!if_copy.is_open()))
+				throw runtime_error("unable to open signatures for comparison");
+
+			vector<char> source_chunk(64 << 10), copy_chunk(64 << 10);
+			while ((ret_val) && (if_source || if_copy)) {
+				if_source.read(source_chunk.data(), source_chunk.size());
+				if_copy.read(copy_chunk.data(), copy_chunk.size());
+				ret_val = (if_source.gcount() == if_copy.gcount()) &&
+						  equal(source_chunk.begin(), source_chunk.begin() + if_source.gcount(),
+								copy_chunk.begin());
+			}
+
+			error_code ec;
+			filesystem::remove(output_path(verify_output, alg), ec);
+		}
+	}
+	catch (exception& e) {
+		sync_print("Copy verification error: " + string(e.what()), true);
+		return false;
+	}
+
+	if (ret_val)
+		sync_print("Copy " + copy_destination + " is identical to the input file", false);
+	else
+		sync_print("Copy " + copy_destination + " differs from the input file", true);
+	return ret_val;
 }
 
 
@@ -374,26 +593,29 @@ bool fileSignaturer::clear_cache() noexcept(true)
 
 	if (caches_threads.size() > 0) {
 
-		if ((!stop_computations.load(memory_order_acquire)) && (!computations_complete))
+		// Suspended work threads (computations haven't been started) are released to quit
+		if (!computations_complete)
 			release_workers(true, false);
 
 		wait_for_workers();
 
 		for ( auto& cachethread : caches_threads ) {
-			if (cachestorage_available) {
-				if (filesystem::exists(cachethread.first, ec)) {
-					filesystem::remove(cachethread.first, ec);
-					if (ec) {
-						sync_print("Cache clearing error: " + ec.message() +
-								   " at file " + cachethread.first, true);
+			for ( auto& cache : cachethread.first ) {
+				if (cachestorage_available) {
+					if (filesystem::exists(cache, ec)) {
+						filesystem::remove(cache, ec);
+						if (ec) {
+							sync_print("Cache clearing error: " + ec.message() +
+									   " at file " + cache, true);
+							ret_val = false;
+						}
+					} else {
+						sync_print("Missing cache file: " + cache, true);
 						ret_val = false;
 					}
 				} else {
-					sync_print("Missing cache file: " + cachethread.first, true);
-					ret_val = false;
+					cache = "";
 				}
-			} else {
-				cachethread.first = "";
 			}
 		}
 
@@ -6,18 +6,24 @@
 #include <fstream>
 #include <filesystem>
 #include <thread>
+#include <atomic>
+#include <mutex>
+#include <map>
+#include <cmath>
 #include <random>
 #include <condition_variable>
 #if defined(__linux__)
 	#include <pwd.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <cstring>
 #endif
-#include <boost/algorithm/hex.hpp>
-#include <boost/uuid/detail/md5.hpp>
-using boost::algorithm::hex;
-using boost::uuids::detail::md5;
 using namespace std;
 
 #include "signaturer.h"
+#include "hashEngine.h"
+#include "blockHasher.h"
+#include "ioThrottle.h"
 
 
 /**
@@ -28,6 +34,29 @@ using namespace std;
  */
 class fileSignaturer : public signaturer
 {
+public:
+
+	/**
+	 * @brief Suffix of the temporary file the signature is assembled in
+	 * before being atomically renamed to the requested output file.
+	 */
+	static constexpr const char* tmpoutput_suffix = ".signa-tmp";
+
+	/**
+	 * @brief First word of a partial signature's header line.
+	 * Header format: SIGNA-PARTIAL ALGORITHM INPUTSIZE BLOCKSIZE BEGIN END
+	 * (sizes in bytes, blocks' range is [BEGIN, END)).
+	 *
+	 * @see partial_header()
+	 */
+	static constexpr const char* partialheader_magic = "SIGNA-PARTIAL";
+
+	/**
+	 * @brief Default size of a single read of the input file (in bytes).
+	 * @see segment_size
+	 */
+	static constexpr uintmax_t default_segment_size = 4 << 20;
+
 protected:
 
 	/**
@@ -36,17 +65,62 @@ protected:
 	string input_file;
 
 	/**
-	* @brief Size of the input file (in bytes).
+	* @brief Size of the input file (in bytes), uncompressed size
+	* for the input file in the zstd seekable format.
 	* @see input_file
 	*/
 	uintmax_t inputfile_size;
 
+	/**
+	 * @brief Flag of the input file in the zstd seekable format, its
+	 * uncompressed contents are fingerprinted.
+	 */
+	bool zstd_seekable;
+
 	/**
 	 * @brief Given size of the input file's hashing unit,
 	 * transformed from Mb to bytes.
 	 */
 	uintmax_t block_size;
 
+	/**
+	 * @brief Names of the blocks' hashing algorithms, every one of them
+	 * gets its own signature computed during the same reading of the input file.
+	 */
+	vector<string> hash_algorithms;
+
+	/**
+	 * @brief Size of a single read of the input file (in bytes).
+	 * Every working thread holds two buffers of this size regardless
+	 * of the \a block_size.
+	 *
+	 * @see process_filechunk()
+	 */
+	uintmax_t segment_size;
+
+	/**
+	 * @brief Quantity of blocks in the input file.
+	 */
+	uintmax_t blocks_total;
+
+	/**
+	 * @brief First block of the input file to proceed.
+	 */
+	uintmax_t range_begin;
+
+	/**
+	 * @brief Block following the last block of the input file to proceed.
+	 * @see range_begin
+	 */
+	uintmax_t range_end;
+
+	/**
+	 * @brief Flag of the explicitly given blocks' range: the result is
+	 * a partial signature even if the range covers the whole file.
+	 * @see is_partial()
+	 */
+	bool range_given;
+
 	/**
 	 * @brief Flag of disk (user's home storage) accessibility for
 	 * temporary cache usage in order to reduce RAM consumption.
@@ -59,13 +133,13 @@ protected:
 	string cache_dir;
 
 	/**
-	 * @brief Each entry is a pair of working thread's cache and
-	 * a thread's descriptor. Thread index in the vector is the thread's ID.
+	 * @brief Each entry is a pair of working thread's caches (one per hashing
+	 * algorithm) and a thread's descriptor. Thread index in the vector is the thread's ID.
 	 * THe size of this data structure is a) the quantity of hashes in the output
 	 * file and b) the number of cores that'll be heavily used throughout the
 	 * active phase of the input file's fingerprint calculating.
 	 */
-	vector<pair<string, thread>> caches_threads;
+	vector<pair<vector<string>, thread>> caches_threads;
 
 	/**
 	 * @brief Guard of working threads suspending by leader thread.
@@ -104,6 +178,26 @@ protected:
 	 */
 	atomic<bool> stop_computations;
 
+	/**
+	 * @brief Optional limiter of the input file reading shared by working threads.
+	 * @see set_io_throttle()
+	 */
+	shared_ptr<ioThrottle> io_throttle;
+
+	/**
+	 * @brief Path to the copy of the input file written during
+	 * fingerprinting (empty - no copying).
+	 * @see set_copy_destination()
+	 */
+	string copy_destination;
+
+	/**
+	 * @brief The copy's file has been created by this run, so its directory
+	 * entry has to be synced too.
+	 * @see sync_copy()
+	 */
+	bool copy_created = false;
+
 	/**
 	* @brief Given level of additional information provided to user during
 	* active phase of fingerprint computations.
@@ -140,9 +234,13 @@ protected:
 
 	/**
 	 * @brief Reads specified blocks' range of the input file,
-	 * compute blocks' MD5 hash values and store these values into cache.
+	 * compute blocks' hash values and store these values into caches.
+	 * The range is read by \a segment_size pieces, double-buffered
+	 * (the next piece is read while the current one is hashed).
 	 * Working thread method.
 	 *
+	 * @see blockHasher
+	 *
 	 * @param thread_id Thread's identifier
 	 * @param begin_block First block to proceed
 	 * @param end_block Last block to proceed
@@ -151,10 +249,24 @@ protected:
 	virtual void process_filechunk(const uint thread_id,
 									const uintmax_t begin_block, const uintmax_t end_block) noexcept(true);
 
+	/**
+	 * @brief Appends a block's hash value to the working thread's cache.
+	 * @param thread_id Thread's identifier
+	 * @param alg Index of the hashing algorithm
+	 * @param cipherblock Hexadecimal hash value of the block
+	 * @throws runtime_error File system access errors
+	 *
+	 * @see caches_threads, hash_algorithms
+	 */
+	virtual void store_hash(const uint thread_id, const size_t alg,
+							const string& cipherblock) noexcept(false);
+
 	/**
 	 * @brief Gathers temporary cached chunks of the computed signature into the one
-	 * result \a output file.
+	 * result \a output file. The result is written to a temporary file next to
+	 * the \a output file and then renamed, so the replacement is atomic.
 	 * @param output Path to the output result file
+	 * @param alg Index of the hashing algorithm
 	 * @return status
 	 * @value true success
 	 * @value false fail
@@ -162,7 +274,18 @@ protected:
 	 *
 	 * @see save_signature(), caches_threads
 	 */
-	virtual bool assemble_output(const string& output) const noexcept(true);
+	virtual bool assemble_output(const string& output, const size_t alg) const noexcept(true);
+
+	/**
+	 * @brief Path to the signature of a hashing algorithm.
+	 * @param output Path to the output result file
+	 * @param alg Index of the hashing algorithm
+	 * @return \a output for a single algorithm, \a output.ALGORITHM otherwise
+	 * @throws bad_alloc
+	 *
+	 * @see save_signature()
+	 */
+	virtual string output_path(const string& output, const size_t alg) const noexcept(false);
 
 	/**
 	 * @brief Cleans temporary cached hash data, stops and "flush" working threads
@@ -195,6 +318,42 @@ protected:
 	 */
 	virtual void sync_print(const string& str, bool is_errmsg) const noexcept(true);
 
+	/**
+	 * @brief Checks whether a partial signature is computed: the blocks' range
+	 * has been given explicitly (so a range covering the whole file still
+	 * produces a mergeable partial signature).
+	 * @return status
+	 * @value true partial signature
+	 * @value false whole signature
+	 * @exceptsafe Shall not throw exceptions.
+	 *
+	 * @see range_given
+	 */
+	virtual bool is_partial() const noexcept(true);
+
+	/**
+	 * @brief Describes a partial signature, so partial signatures computed
+	 * separately (e.g. on different hosts) can be validated and merged.
+	 * @param alg Index of the hashing algorithm
+	 * @return Header line of the partial signature
+	 * @throws bad_alloc
+	 *
+	 * @see partialheader_magic, signaturesMerger
+	 */
+	virtual string partial_header(const size_t alg) const noexcept(false);
+
+	/**
+	 * @brief Flushes the copy to its storage device (Linux), and
+	 * its directory when the copy's file has been created by this run.
+	 * @return status
+	 * @value true the copy is durable
+	 * @value false sync error
+	 * @exceptsafe Shall not throw exceptions.
+	 *
+	 * @see set_copy_destination()
+	 */
+	virtual bool sync_copy() const noexcept(true);
+
 public:
 
 	/**
@@ -204,15 +363,33 @@ public:
 	* determines an optimal cache location, calculates chunks' sizes
 	* based on the \a input file size and the * \a bs (block size),
 	* starts working threads in a suspended state.
+	* Only blocks from \a first_block up to (not including) \a last_block are
+	* proceeded, the result is a partial signature then (even if the range
+	* covers the whole file).
 	* @param input Path to the input source file
 	* @param bs Block size (in Mb, up to 1Gb, default: 1)
-	* @throws logic_error Input file not found, internal errors
+	* @param first_block First block to proceed (default: 0)
+	* @param last_block Block following the last block to proceed
+	* (default: 0, with \a first_block equal to 0 means the whole file)
+	* @param algorithms Names of the hashing algorithms (default: MD5)
+	* @param threads_limit Maximum quantity of working threads
+	* (default: 0, limited by the quantity of CPUs only)
+	* @param read_size Size of a single read in bytes (default: 0, \a default_segment_size)
+	* @param zstd_input Fingerprint uncompressed contents of the input file
+	* in the zstd seekable format (default: false), the result is identical
+	* to the fingerprint of the decompressed file
+	* @throws logic_error Input file not found, incorrect blocks range,
+	* unknown hashing algorithm, internal errors
 	* @throws runtime_error File system access errors
 	* @exceptsafe strong
 	*
 	* @see choose_cache_location()
 	*/
-	fileSignaturer(const string& input, short bs) noexcept(false);
+	fileSignaturer(const string& input, short bs,
+				   uintmax_t first_block = 0, uintmax_t last_block = 0,
+				   const vector<string>& algorithms = {"MD5"},
+				   uint threads_limit = 0, uintmax_t read_size = 0,
+				   bool zstd_input = false) noexcept(false);
 
 	/**
 	 * @brief Calculates signature (fingerprint) for object's input file
@@ -233,8 +410,49 @@ public:
 	 */
 	bool compute_signature(bool verbose) noexcept(true);
 
+	/**
+	 * @brief Sets limiter of the input file reading, shall be called
+	 * before compute_signature().
+	 * @param throttle Limiter shared by working threads (nullptr - no limits)
+	 * @exceptsafe Shall not throw exceptions.
+	 *
+	 * @see ioThrottle
+	 */
+	void set_io_throttle(shared_ptr<ioThrottle> throttle) noexcept(true);
+
+	/**
+	 * @brief Makes working threads write the read data to the \a destination
+	 * at the same offsets, so the input file is copied and fingerprinted
+	 * during one reading. Creates the \a destination (if needed) and sets
+	 * its size to the input file's one. Shall be called before compute_signature(),
+	 * which succeeds only once the copy is synced to its storage device.
+	 * @param destination Path to the copy
+	 * @throws logic_error Copy mode is already set, the destination is the input file
+	 * @throws runtime_error File system access errors
+	 *
+	 * @see verify_copy(), sync_copy()
+	 */
+	void set_copy_destination(const string& destination) noexcept(false);
+
+	/**
+	 * @brief Reads the copy back (bypassing the page cache where possible),
+	 * fingerprints it and compares its signature with the input file's
+	 * one saved to the \a output.
+	 * @param output Path to the saved signature of the input file
+	 * @param verbose Level of additional information provided to the user
+	 * @return status
+	 * @value true the copy is identical
+	 * @value false the copy differs or verification failed
+	 * @exceptsafe Shall not throw exceptions.
+	 *
+	 * @see save_signature(), set_copy_destination()
+	 */
+	bool verify_copy(const string& output, bool verbose) noexcept(true);
+
 	/**
 	 * @brief Saves calculated input file's fingerprint to provided \a output file.
+	 * In case of several hashing algorithms every signature is saved
+	 * to its own file \a output.ALGORITHM (e.g. output.sha256).
 	 * @param output - path to the output result file
 	 * @exceptsafe Shall not throw exceptions.
 	 *
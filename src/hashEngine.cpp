@@ -0,0 +1,100 @@
+
+#include "hashEngine.h"
+
+
+const vector<string> hashEngine::algorithms{"MD5", "SHA1", "SHA256"};
+
+
+string hashEngine::canonical_name(const string& algorithm) noexcept(true)
+{
+	string name(algorithm);
+	transform(name.begin(), name.end(), name.begin(),
+			  [](unsigned char c) { return static_cast<char>(toupper(c)); });
+	name.erase(remove(name.begin(), name.end(), '-'), name.end());
+
+	if (find(algorithms.begin(), algorithms.end(), name) == algorithms.end())
+		return "";
+	return name;
+}
+
+
+unique_ptr<hashEngine> hashEngine::create(const string& algorithm) noexcept(false)
+{
+	const string name = canonical_name(algorithm);
+
+	if (name == "MD5")
+		return make_unique<md5Engine>();
+	if (name == "SHA1")
+		return make_unique<sha1Engine>();
+	if (name == "SHA256")
+		return make_unique<sha256Engine>();
+
+	throw logic_error("Unknown hashing algorithm: " + algorithm);
+}
+
+
+size_t hashEngine::hex_length(const string& algorithm) noexcept(true)
+{
+	const string name = canonical_name(algorithm);
+
+	if (name == "MD5")
+		return 2 * sizeof(md5::digest_type);
+	if (name == "SHA1")
+		return 2 * 20;
+	if (name == "SHA256")
+		return 2 * 32;
+
+	return 0;
+}
+
+
+void md5Engine::process_bytes(const void* buffer, size_t byte_count) noexcept(false)
+{
+	boost_md5.process_bytes(buffer, byte_count);
+}
+
+
+void md5Engine::append_digest(string& cipherblock) noexcept(false)
+{
+	md5::digest_type fingerprint;
+	boost_md5.get_digest(fingerprint);
+	const auto byte_fingerprint = reinterpret_cast<const char*>(&fingerprint);
+	hex(byte_fingerprint, byte_fingerprint+sizeof(md5::digest_type), back_inserter(cipherblock));
+	boost_md5 = md5();
+}
+
+
+evpEngine::evpEngine(const EVP_MD* md, const string& name) noexcept(false)
+	: digest(md), digest_name(name), ctx(EVP_MD_CTX_new(), EVP_MD_CTX_free)
+{
+	if ((!ctx) || (!EVP_DigestInit_ex(ctx.get(), digest, nullptr)))
+		throw runtime_error(digest_name + " initialization error");
+}
+
+
+void evpEngine::process_bytes(const void* buffer, size_t byte_count) noexcept(false)
+{
+	if (!EVP_DigestUpdate(ctx.get(), buffer, byte_count))
+		throw runtime_error(digest_name + " computation error");
+}
+
+
+void evpEngine::append_digest(string& cipherblock) noexcept(false)
+{
+	unsigned char fingerprint[EVP_MAX_MD_SIZE];
+	unsigned int fingerprint_size = 0;
+	if ((!EVP_DigestFinal_ex(ctx.get(), fingerprint, &fingerprint_size)) ||
+		(!EVP_DigestInit_ex(ctx.get(), digest, nullptr)))
+		throw runtime_error(digest_name + " computation error");
+	hex(fingerprint, fingerprint + fingerprint_size, back_inserter(cipherblock));
+}
+
+
+sha1Engine::sha1Engine() noexcept(false) : evpEngine(EVP_sha1(), "SHA-1")
+{
+}
+
+
+sha256Engine::sha256Engine() noexcept(false) : evpEngine(EVP_sha256(), "SHA-256")
+{
+}
@@ -0,0 +1,148 @@
+
+#ifndef HASHENGINE_H_
+#define HASHENGINE_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+#include <algorithm>
+#include <boost/algorithm/hex.hpp>
+#include <boost/uuid/detail/md5.hpp>
+#include <openssl/evp.h>
+using boost::algorithm::hex;
+using boost::uuids::detail::md5;
+using namespace std;
+
+
+/**
+ * @class hashEngine
+ * @brief Streaming hash function interface, one instance computes hash values
+ * of data blocks one after another.
+ * Derived classes: md5Engine, evpEngine (sha1Engine, sha256Engine).
+ */
+class hashEngine
+{
+public:
+
+	/**
+	 * @brief Names of the supported hashing algorithms.
+	 */
+	static const vector<string> algorithms;
+
+	/**
+	 * @brief Creates a hash engine for the named algorithm.
+	 * @param algorithm Name of the hashing algorithm (case insensitive)
+	 * @return Hash engine
+	 * @throws logic_error Unknown algorithm
+	 */
+	static unique_ptr<hashEngine> create(const string& algorithm) noexcept(false);
+
+	/**
+	 * @brief Converts the algorithm's name to the canonical (upper case) form.
+	 * @param algorithm Name of the hashing algorithm
+	 * @return Canonical name, empty for an unknown algorithm
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	static string canonical_name(const string& algorithm) noexcept(true);
+
+	/**
+	 * @brief Length of the hexadecimal representation of the algorithm's hash value.
+	 * @param algorithm Name of the hashing algorithm
+	 * @return Hash length (0 for an unknown algorithm)
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	static size_t hex_length(const string& algorithm) noexcept(true);
+
+	/**
+	 * @brief Feeds the next piece of the current data block.
+	 * @param buffer Data
+	 * @param byte_count Size of the data
+	 * @throws runtime_error Hashing library errors
+	 */
+	virtual void process_bytes(const void* buffer, size_t byte_count) noexcept(false) = 0;
+
+	/**
+	 * @brief Completes the current data block and appends its hash value
+	 * (upper case hexadecimal) to \a cipherblock. The engine is ready for the next block.
+	 * @param cipherblock Destination string
+	 * @throws runtime_error Hashing library errors
+	 */
+	virtual void append_digest(string& cipherblock) noexcept(false) = 0;
+
+	/**
+	 * @brief Destructor of the hashEngine base class.
+	 */
+	virtual ~hashEngine() = default;
+};
+
+
+/**
+ * @class md5Engine
+ * @brief MD5 hash engine (Boost), hash values' format of the original Signa.
+ */
+class md5Engine : public hashEngine
+{
+protected:
+	md5 boost_md5;
+
+public:
+	void process_bytes(const void* buffer, size_t byte_count) noexcept(false);
+	void append_digest(string& cipherblock) noexcept(false);
+};
+
+
+/**
+ * @class evpEngine
+ * @brief Hash engine of an OpenSSL (libcrypto) digest.
+ * Derived classes: sha1Engine, sha256Engine.
+ */
+class evpEngine : public hashEngine
+{
+protected:
+	const EVP_MD* digest;
+	string digest_name;
+	unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> ctx;
+
+	/**
+	 * @param md OpenSSL digest
+	 * @param name Name of the digest for error messages
+	 * @throws runtime_error Hashing library errors
+	 */
+	evpEngine(const EVP_MD* md, const string& name) noexcept(false);
+
+public:
+	void process_bytes(const void* buffer, size_t byte_count) noexcept(false);
+	void append_digest(string& cipherblock) noexcept(false);
+};
+
+
+/**
+ * @class sha1Engine
+ * @brief SHA-1 hash engine (OpenSSL).
+ */
+class sha1Engine : public evpEngine
+{
+public:
+	/**
+	 * @throws runtime_error Hashing library errors
+	 */
+	sha1Engine() noexcept(false);
+};
+
+
+/**
+ * @class sha256Engine
+ * @brief SHA-256 hash engine (OpenSSL).
+ */
+class sha256Engine : public evpEngine
+{
+public:
+	/**
+	 * @throws runtime_error Hashing library errors
+	 */
+	sha256Engine() noexcept(false);
+};
+
+
+#endif /* HASHENGINE_H_ */
@@ -0,0 +1,130 @@
+
+#include "ioThrottle.h"
+
+
+namespace {
+	// Burst of reads allowed after idling (seconds of the current rate)
+	constexpr double burst_duration = 0.1;
+	// Duration of the latency observation window (seconds)
+	constexpr double window_duration = 0.2;
+	// Read latency exceeding the baseline one this many times means saturation
+	constexpr double saturation_factor = 2.0;
+	// Lowest rate the feedback controller may set (bytes per second)
+	constexpr double min_rate = 1 << 20;
+
+#if defined(__linux__)
+	// ioprio_set(2) has no glibc wrapper
+	constexpr int ioprio_who_process = 1;
+	constexpr int ioprio_class_idle = 3;
+	constexpr int ioprio_class_shift = 13;
+#endif
+}
+
+
+ioThrottle::ioThrottle(uint max_bandwidth, bool adaptive_mode, bool idle_mode) noexcept(true)
+{
+	this->max_rate = static_cast<double>(max_bandwidth) * (1 << 20);
+	this->rate = max_rate;
+	this->tokens = rate * burst_duration;
+	this->refill_time = chrono::steady_clock::now();
+	this->adaptive = adaptive_mode;
+	this->idle_priority = idle_mode;
+	this->window_start = refill_time;
+	this->window_bytes = 0;
+	this->window_latency = 0;
+	this->baseline_latency = 0;
+}
+
+
+bool ioThrottle::apply_priority() const noexcept(true)
+{
+	if (!idle_priority)
+		return true;
+
+#if defined(__linux__)
+	// 0 - the calling thread, threads started by it inherit its I/O priority
+	return syscall(SYS_ioprio_set, ioprio_who_process, 0,
+				   ioprio_class_idle << ioprio_class_shift) == 0;
+#else
+	return false;
+#endif
+}
+
+
+void ioThrottle::refill(const chrono::steady_clock::time_point& now) noexcept(true)
+{
+	const double elapsed = chrono::duration<double>(now - refill_time).count();
+	refill_time = now;
+	tokens = min(tokens + elapsed * rate, rate * burst_duration);
+}
+
+
+void ioThrottle::acquire(uintmax_t bytes) noexcept(true)
+{
+	auto lock = unique_lock<mutex>(throttle_mutex);
+	if (rate <= 0)
+		return;
+
+	refill(chrono::steady_clock::now());
+
+	// Grant the read at once and make the caller wait for the debt
+	tokens -= static_cast<double>(bytes);
+	const double wait = (tokens < 0) ? (-tokens / rate) : 0;
+	lock.unlock();
+
+	if (wait > 0)
+		this_thread::sleep_for(chrono::duration<double>(wait));
+}
+
+
+void ioThrottle::report(uintmax_t bytes, const chrono::steady_clock::duration& latency) noexcept(true)
+{
+	if ((!adaptive) || (!bytes))
+		return;
+
+	const auto now = chrono::steady_clock::now();
+	auto lock = unique_lock<mutex>(throttle_mutex);
+
+	window_bytes += static_cast<double>(bytes);
+	window_latency += chrono::duration<double>(latency).count();
+
+	if (chrono::duration<double>(now - window_start).count() >= window_duration)
+		adjust_rate(now);
+}
+
+
+void ioThrottle::adjust_rate(const chrono::steady_clock::time_point& now) noexcept(true)
+{
+	refill(now);
+
+	const double window_time = chrono::duration<double>(now - window_start).count();
+	const double throughput = window_bytes / window_time;
+	const double latency = window_latency / window_bytes;
+
+	if ((baseline_latency <= 0) || (latency < baseline_latency))
+		baseline_latency = latency;
+
+	if (latency > baseline_latency * saturation_factor) {
+		// Device is saturated: back off below the achieved throughput
+		const double limit = (rate > 0) ? min(rate, throughput) : throughput;
+		rate = max(limit * 0.7, min_rate);
+		tokens = min(tokens, rate * burst_duration);
+	} else {
+		// Baseline slowly drifts upwards towards the latency of the non-saturated
+		// device only, so a changed device's state is learnt again, while
+		// sustained saturation never becomes the norm
+		baseline_latency = min(baseline_latency * 1.01, latency);
+
+		if (rate > 0) {
+			rate += rate / 10 + min_rate;
+			if (max_rate > 0)
+				rate = min(rate, max_rate);
+			else if (rate > 2 * throughput)
+				rate = 0; // the limit doesn't constrain reading anymore
+		}
+	}
+
+	window_start = now;
+	window_bytes = 0;
+	window_latency = 0;
+}
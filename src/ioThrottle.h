@@ -0,0 +1,151 @@
+
+#ifndef IOTHROTTLE_H_
+#define IOTHROTTLE_H_
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <algorithm>
+#if defined(__linux__)
+	#include <unistd.h>
+	#include <sys/syscall.h>
+#endif
+using namespace std;
+
+
+/**
+ * @class ioThrottle
+ * @brief Limits input reading of the working threads, so fingerprinting
+ * yields to foreground I/O. Shared by all working threads.
+ * Consists of a token bucket (bandwidth limit), an optional latency feedback
+ * controller (backs off when reads become slow, i.e. the device is saturated)
+ * and the idle I/O scheduling class support.
+ */
+class ioThrottle
+{
+protected:
+
+	/**
+	 * @brief Guard of the throttle state shared by working threads.
+	 */
+	mutex throttle_mutex;
+
+	/**
+	 * @brief User provided bandwidth limit (bytes per second, 0 - unlimited).
+	 */
+	double max_rate;
+
+	/**
+	 * @brief Current bandwidth limit (bytes per second, 0 - unlimited).
+	 * Equal to \a max_rate unless lowered by the feedback controller.
+	 */
+	double rate;
+
+	/**
+	 * @brief Bytes available for reading without waiting,
+	 * negative value is a debt of already granted reads.
+	 */
+	double tokens;
+
+	/**
+	 * @brief Moment of the last \a tokens refill.
+	 */
+	chrono::steady_clock::time_point refill_time;
+
+	/**
+	 * @brief Flag of the latency feedback controller.
+	 */
+	bool adaptive;
+
+	/**
+	 * @brief Flag of the idle I/O scheduling class usage.
+	 */
+	bool idle_priority;
+
+	/**
+	 * @brief Start of the current latency observation window.
+	 */
+	chrono::steady_clock::time_point window_start;
+
+	/**
+	 * @brief Bytes read during the current observation window.
+	 */
+	double window_bytes;
+
+	/**
+	 * @brief Total reads' latency during the current observation window (seconds).
+	 */
+	double window_latency;
+
+	/**
+	 * @brief Lowest observed read latency per byte (seconds),
+	 * latency of the non-saturated device. Drifts upwards only
+	 * while the device isn't saturated.
+	 */
+	double baseline_latency;
+
+	/**
+	 * @brief Recalculates \a tokens according to the time passed.
+	 * Shall be called under \a throttle_mutex.
+	 * @param now Current moment
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	virtual void refill(const chrono::steady_clock::time_point& now) noexcept(true);
+
+	/**
+	 * @brief Adjusts \a rate at the end of an observation window:
+	 * multiplicative decrease when read latency per byte considerably exceeds
+	 * the baseline one, additive increase otherwise.
+	 * Shall be called under \a throttle_mutex.
+	 * @param now Current moment
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	virtual void adjust_rate(const chrono::steady_clock::time_point& now) noexcept(true);
+
+public:
+
+	/**
+	 * @brief Creates instance of the ioThrottle class.
+	 * @param max_bandwidth Bandwidth limit (Mb per second, 0 - unlimited)
+	 * @param adaptive_mode Back off when the device is saturated
+	 * @param idle_mode Use the idle I/O scheduling class for reading
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	ioThrottle(uint max_bandwidth, bool adaptive_mode, bool idle_mode) noexcept(true);
+
+	/**
+	 * @brief Puts the calling thread (and threads it starts afterwards)
+	 * into the idle I/O scheduling class if needed.
+	 * Working thread method.
+	 * @return status
+	 * @value true success
+	 * @value false fail
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	bool apply_priority() const noexcept(true);
+
+	/**
+	 * @brief Hangs until reading of \a bytes is allowed.
+	 * Working thread method.
+	 * @param bytes Size of the upcoming read
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	void acquire(uintmax_t bytes) noexcept(true);
+
+	/**
+	 * @brief Feeds the latency controller with a completed read.
+	 * Working thread method.
+	 * @param bytes Size of the completed read
+	 * @param latency Duration of the completed read
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	void report(uintmax_t bytes, const chrono::steady_clock::duration& latency) noexcept(true);
+
+	/**
+	 * @brief Destructor of the ioThrottle class.
+	 */
+	virtual ~ioThrottle() = default;
+};
+
+
+#endif /* IOTHROTTLE_H_ */
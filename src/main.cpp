@@ -8,6 +8,10 @@
 namespace po = boost::program_options;
 
 #include "fileSignaturer.h"
+#include "signaturesWatcher.h"
+#include "signaturesMerger.h"
+#include "deviceTuner.h"
+#include "duplicatesFinder.h"
 
 
 /**
@@ -18,11 +22,25 @@ namespace po = boost::program_options;
  *
  * @section syn_sec Command Syntax
  * Signa --input INPUTFILE --output OUTPUTFILE [ --block_size BS ] [ --verbose FLAG ]
+ *       [ --digest ALGORITHM... ] [ --zstd_seekable ] [ --copy_to DEST [ --verify_copy ] ] [ --autotune ] [ --max_bandwidth MBPS ] [ --adaptive_io ] [ --idle_io ]
+ * Signa --input INPUTFILE --output PARTIALFILE --block_range BEGIN:END [ --block_size BS ] [ --verbose FLAG ]
+ * Signa --merge PARTIALFILE... --output OUTPUTFILE [ --verbose FLAG ]
+ * Signa --duplicates --input INPUTDIR --output OUTPUTFILE [ --block_size BS ] [ --digest ALGORITHM... ]
+ * Signa --watch --input INPUTDIR --output OUTPUTDIR [ --debounce MS ] [ --block_size BS ] [ --verbose FLAG ]
  *
  * @section call_example Call Examples
  * Signa --input "input.file" --block_size "45" --output "output.file"
  * Signa -i "input.file" -bs "10" -o "output.file"
  * Signa --input "input.file" --output "output.file" --verbose true
+ * Signa -i "input.file" -o "output.file" --digest md5 sha256
+ * Signa -i "input.file" -o "output.file" --autotune
+ * Signa -i "input.file.zst" -o "output.file" --zstd_seekable
+ * Signa -i "input.file" -o "output.file" --copy_to "/storage/input.file" --verify_copy
+ * Signa -i "input.file" -o "output.file" --max_bandwidth 100 --adaptive_io --idle_io
+ * Signa -i "input.file" -o "part0.file" --block_range 0:512
+ * Signa --merge "part0.file" "part1.file" --output "output.file"
+ * Signa --duplicates --input "input.dir" --output "duplicates.txt"
+ * Signa --watch --input "input.dir" --output "signatures.dir" --debounce 2000
  * Signa -h
  */
 int main(int argc, char **argv) {
@@ -34,7 +52,27 @@ int main(int argc, char **argv) {
 				 ("output,o", po::value<string>(), "path to the output file")
 		         ("block_size,bs", po::value<short>(),
 		        		 "size of the input file's hashing unit (Mb, a natural number less than or equal to 1 Gb), default: 1 Mb")
-				 ("verbose,v", po::value<bool>(), "output detailed information (default: false)");
+				 ("verbose,v", po::value<bool>(), "output detailed information (default: false)")
+				 ("digest", po::value<vector<string>>()->multitoken(),
+						 "hashing algorithms computed during one reading: md5, sha1, sha256 (several ones "
+						 "are saved to OUTPUTFILE.ALGORITHM files), default: md5")
+				 ("zstd_seekable", "fingerprint uncompressed contents of the input file in the zstd seekable format")
+				 ("copy_to", po::value<string>(), "copy the input file to DEST during the same reading")
+				 ("verify_copy", "read the copy back and compare its signature with the input file's one")
+				 ("autotune", "choose threads' quantity and read size for the input file's device "
+						 "(results are cached per device)")
+				 ("max_bandwidth", po::value<uint>(),
+						 "limit of the input file reading (Mb per second), default: unlimited")
+				 ("adaptive_io", "slow down the input file reading when the device is saturated")
+				 ("idle_io", "read the input file with idle I/O priority (Linux)")
+				 ("block_range", po::value<string>(),
+						 "compute a partial signature of the input file's blocks BEGIN:END (zero-based, END is excluded)")
+				 ("merge", po::value<vector<string>>()->multitoken(),
+						 "merge partial signatures into the whole signature")
+				 ("duplicates,d", "find groups of identical files in the input directory tree")
+				 ("watch,w", "keep signatures of the input directory's files up to date (input and output are directories)")
+				 ("debounce", po::value<uint>(),
+						 "quiet period after a file change before its re-fingerprinting in watch mode (ms), default: 500 ms");
 
 		po::variables_map vm;
 		po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -45,6 +83,30 @@ int main(int argc, char **argv) {
 			return 0;
 		}
 
+		bool verbose = false;
+		if (vm.count("verbose")) {
+			if (vm["verbose"].as<bool>() == true) {
+				verbose = vm["verbose"].as<bool>();
+				cout << "Verbose = " << verbose << endl;
+			}
+		}
+
+		if (vm.count("merge")) {
+			if (!vm.count("output")) {
+				cerr << "Output file path not specified." << endl;
+				return 2;
+			}
+
+			signaturesMerger smerger(vm["merge"].as<vector<string>>());
+			if (!smerger.compute_signature(verbose))
+				return 4;
+			if (!smerger.save_signature(vm["output"].as<string>()))
+				return 5;
+
+			cout << "Done" << endl;
+			return 0;
+		}
+
 		if (vm.count("input")) {
 			cout << "Input file path: "
 					<< vm["input"].as<string>() << endl;
@@ -71,21 +133,106 @@ int main(int argc, char **argv) {
 		}
 		cout << "Block size = "	<< bs << " Mb" << endl;
 
-		bool verbose = false;
-		if (vm.count("verbose")) {
-			if (vm["verbose"].as<bool>() == true) {
-				verbose = vm["verbose"].as<bool>();
-				cout << "Verbose = " << verbose << endl;
+		uintmax_t first_block = 0;
+		uintmax_t last_block = 0;
+		if (vm.count("block_range")) {
+			const string range = vm["block_range"].as<string>();
+			const size_t delim = range.find(':');
+			size_t first_end = 0, last_end = 0;
+			try {
+				if ((delim == string::npos) || (range.find_first_of("+-") != string::npos))
+					throw invalid_argument(range);
+				first_block = stoull(range.substr(0, delim), &first_end);
+				last_block = stoull(range.substr(delim + 1), &last_end);
+			}
+			catch (logic_error&) {
+				first_end = last_end = 0;
+			}
+			if ((first_end != delim) || (last_end != range.size() - delim - 1) ||
+				(first_block >= last_block)) {
+				cerr << "Block range must be BEGIN:END, BEGIN < END." << endl;
+				return 3;
 			}
+			cout << "Block range = " << first_block << ":" << last_block << endl;
 		}
 
-		fileSignaturer fsigner(vm["input"].as<string>(), bs);
+		if ((vm.count("verify_copy")) && (!vm.count("copy_to"))) {
+			cerr << "Copy verification requires a copy destination (--copy_to)." << endl;
+			return 3;
+		}
+
+		if (vm.count("watch")) {
+			uint debounce_ms = 500;
+			if (vm.count("debounce"))
+				debounce_ms = vm["debounce"].as<uint>();
+			cout << "Debounce = " << debounce_ms << " ms" << endl;
+
+			signaturesWatcher swatcher(vm["input"].as<string>(), vm["output"].as<string>(),
+									   bs, debounce_ms);
+			if (!swatcher.run(verbose))
+				return 8;
+
+			cout << "Done" << endl;
+			return 0;
+		}
+
+		vector<string> algorithms{"MD5"};
+		if (vm.count("digest")) {
+			algorithms = vm["digest"].as<vector<string>>();
+			cout << "Hashing algorithms =";
+			for (const auto& algorithm : algorithms)
+				cout << " " << algorithm;
+			cout << endl;
+		}
+
+		shared_ptr<ioThrottle> throttle = nullptr;
+		if (vm.count("max_bandwidth") || vm.count("adaptive_io") || vm.count("idle_io")) {
+			const uint max_bandwidth = vm.count("max_bandwidth") ? vm["max_bandwidth"].as<uint>() : 0;
+			cout << "Max bandwidth = " << max_bandwidth << " Mb/s" << endl;
+			throttle = make_shared<ioThrottle>(max_bandwidth,
+											   vm.count("adaptive_io") > 0,
+											   vm.count("idle_io") > 0);
+		}
+
+		if (vm.count("duplicates")) {
+			duplicatesFinder dfinder(vm["input"].as<string>(), bs, algorithms, throttle);
+
+			if (!dfinder.compute_signature(verbose))
+				return 4;
+
+			if (!dfinder.save_signature(vm["output"].as<string>()))
+				return 5;
+
+			cout << "Done" << endl;
+			return 0;
+		}
+
+		uint threads_limit = 0;
+		uintmax_t read_size = 0;
+		if (vm.count("autotune")) {
+			deviceTuner dtuner(vm["input"].as<string>(), algorithms);
+			if (dtuner.tune(verbose)) {
+				threads_limit = dtuner.threads();
+				read_size = dtuner.segment_size();
+			}
+		}
+
+		fileSignaturer fsigner(vm["input"].as<string>(), bs, first_block, last_block, algorithms,
+							   threads_limit, read_size, vm.count("zstd_seekable") > 0);
+		fsigner.set_io_throttle(throttle);
+
+		if (vm.count("copy_to"))
+			fsigner.set_copy_destination(vm["copy_to"].as<string>());
 
 		if (!fsigner.compute_signature(verbose))
 			return 4;
 
 		if (!fsigner.save_signature(vm["output"].as<string>()))
 			return 5;
+
+		if ((vm.count("verify_copy")) &&
+			(!fsigner.verify_copy(vm["output"].as<string>(), verbose)))
+			return 9;
     }
 	catch(exception& e) {
 		cerr << "error: " << e.what() << endl;
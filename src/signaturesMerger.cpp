@@ -0,0 +1,156 @@
+
+#include "signaturesMerger.h"
+
+
+signaturesMerger::signaturesMerger(const vector<string>& inputs) noexcept(false)
+{
+	if (inputs.empty())
+		throw logic_error(std::string("No partial signatures to merge"));
+
+	for (const auto& input : inputs) {
+		if ((!filesystem::exists(input)) || (filesystem::is_directory(input)))
+			throw logic_error(std::string("File not found: ") + input);
+		partials.push_back(partial_settings{input, "", 0, 0, 0, 0, 0});
+	}
+
+	this->validation_complete = false;
+}
+
+
+size_t signaturesMerger::hash_length(const string& algorithm) const noexcept(true)
+{
+	if (hashEngine::canonical_name(algorithm) != algorithm)
+		return 0;
+
+	return hashEngine::hex_length(algorithm);
+}
+
+
+signaturesMerger::partial_settings signaturesMerger::read_header(const string& path) const noexcept(false)
+{
+	ifstream if_partial(path, ios_base::in | ios_base::binary);
+	if (!if_partial.is_open())
+		throw runtime_error(path + " error on open");
+
+	string header;
+	if (!getline(if_partial, header))
+		throw logic_error(path + " is empty");
+
+	partial_settings settings{path, "", 0, 0, 0, 0, 0};
+	string magic;
+	istringstream fields(header);
+	if ((!(fields >> magic >> settings.algorithm >> settings.inputfile_size >> settings.block_size
+				  >> settings.range_begin >> settings.range_end)) ||
+		(magic != fileSignaturer::partialheader_magic))
+		throw logic_error(path + " is not a partial signature");
+
+	if (!hash_length(settings.algorithm))
+		throw logic_error(path + " unknown hashing algorithm: " + settings.algorithm);
+
+	if ((!settings.block_size) || (settings.range_begin >= settings.range_end))
+		throw logic_error(path + " malformed header: " + header);
+
+	settings.hashes_offset = if_partial.tellg();
+
+	// Every block of the range has exactly one hash value
+	error_code ec;
+	const uintmax_t partial_size = filesystem::file_size(path, ec);
+	if (ec)
+		throw runtime_error("Estimating size of " + path + " error: " + ec.message());
+	if (partial_size - settings.hashes_offset !=
+			(settings.range_end - settings.range_begin) * hash_length(settings.algorithm))
+		throw logic_error(path + " hash values don't match blocks range " +
+						  to_string(settings.range_begin) + ":" + to_string(settings.range_end));
+
+	return settings;
+}
+
+
+bool signaturesMerger::compute_signature(bool verbose) noexcept(true)
+{
+	try {
+		for (auto& partial : partials) {
+			partial = read_header(partial.path);
+			if (verbose)
+				cout << partial.path << ": blocks " << partial.range_begin << " to "
+					 << partial.range_end << endl;
+		}
+
+		sort(partials.begin(), partials.end(),
+			 [](const partial_settings& a, const partial_settings& b) {
+				return a.range_begin < b.range_begin; });
+
+		const partial_settings& first = partials.front();
+		const uintmax_t blocks_total = (first.inputfile_size > 0) ?
+				static_cast<uintmax_t>(ceil(first.inputfile_size / static_cast<double>(first.block_size))) : 1;
+
+		uintmax_t next_block = 0;
+		for (const auto& partial : partials) {
+			if ((partial.algorithm != first.algorithm) ||
+				(partial.inputfile_size != first.inputfile_size) ||
+				(partial.block_size != first.block_size))
+				throw logic_error(partial.path + " doesn't match " + first.path +
+								  " (input file size, algorithm or block size)");
+
+			if (partial.range_begin < next_block)
+				throw logic_error(partial.path + " overlaps with another partial signature at block " +
+								  to_string(partial.range_begin));
+			if (partial.range_begin > next_block)
+				throw logic_error("Blocks " + to_string(next_block) + " to " +
+								  to_string(partial.range_begin) + " are not covered");
+
+			next_block = partial.range_end;
+		}
+
+		if (next_block != blocks_total)
+			throw logic_error("Blocks " + to_string(next_block) + " to " +
+							  to_string(blocks_total) + " are not covered");
+	}
+	catch (exception& e) {
+		cerr << "Partial signatures validation error: " << e.what() << endl;
+		return false;
+	}
+
+	validation_complete = true;
+	cout << "Partial signatures are consistent" << endl;
+	return true;
+}
+
+
+bool signaturesMerger::save_signature(const string& output) const noexcept(true)
+{
+	if (!validation_complete) {
+		cerr << "Nothing to save. Partial signatures are not validated" << endl;
+		return false;
+	}
+
+	const string tmp_output = output + fileSignaturer::tmpoutput_suffix;
+	error_code ec;
+
+	try {
+		ofstream of_whole;
+		of_whole.exceptions(ofstream::badbit | ofstream::failbit);
+		of_whole.open(tmp_output, ios_base::out | ios_base::binary | ios_base::trunc);
+		for (const auto& partial : partials) {
+			ifstream if_partial(partial.path, ios_base::in | ios_base::binary);
+			if (!if_partial.is_open())
+				throw runtime_error(partial.path + " error on open");
+			if_partial.seekg(partial.hashes_offset);
+			of_whole << if_partial.rdbuf();
+		}
+		of_whole.close();
+
+		filesystem::rename(tmp_output, output, ec);
+		if (ec)
+			throw runtime_error(output +
+					" unsuccessful overwrite attempt of an existing file: " + ec.message());
+	}
+	catch (exception& e) {
+		cerr << "Merging error: " << e.what() << endl;
+		filesystem::remove(tmp_output, ec);
+		return false;
+	}
+
+	cout << "Signature has been saved" << endl;
+	return true;
+}
@@ -0,0 +1,101 @@
+
+#ifndef SIGNATURESMERGER_H_
+#define SIGNATURESMERGER_H_
+
+#include <sstream>
+#include <algorithm>
+
+#include "fileSignaturer.h"
+
+
+/**
+ * @class signaturesMerger
+ * @brief Assembles the whole fingerprint of an input file from its partial
+ * signatures (each one covers a range of the input file's blocks and
+ * could be computed by a different process or host).
+ * Partials must describe the same input file size, hashing algorithm
+ * and block size, and cover all of the input file's blocks without overlaps.
+ *
+ * @see fileSignaturer::partial_header()
+ */
+class signaturesMerger : public signaturer
+{
+protected:
+
+	/**
+	 * @brief Parsed header of a partial signature.
+	 */
+	struct partial_settings
+	{
+		string path;
+		string algorithm;
+		uintmax_t inputfile_size;
+		uintmax_t block_size;
+		uintmax_t range_begin;
+		uintmax_t range_end;
+		streamoff hashes_offset;
+	};
+
+	/**
+	 * @brief Partial signatures ordered by their first block.
+	 */
+	vector<partial_settings> partials;
+
+	/**
+	 * @brief Flag of successfully validated partial signatures.
+	 * @see compute_signature()
+	 */
+	bool validation_complete;
+
+	/**
+	 * @brief Reads and checks a partial signature's header.
+	 * @param path Path to the partial signature
+	 * @return Partial signature's settings
+	 * @throws logic_error Malformed partial signature
+	 * @throws runtime_error File system access errors
+	 */
+	virtual partial_settings read_header(const string& path) const noexcept(false);
+
+	/**
+	 * @brief Length of the hexadecimal representation of a block's hash.
+	 * @param algorithm Name of the hashing algorithm
+	 * @return Hash length (0 for an unknown algorithm)
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	virtual size_t hash_length(const string& algorithm) const noexcept(true);
+
+public:
+
+	/**
+	 * @brief Creates instance of the signaturesMerger class.
+	 * @param inputs Paths to the partial signatures (in any order)
+	 * @throws logic_error Partial signatures not found
+	 * @exceptsafe strong
+	 */
+	signaturesMerger(const vector<string>& inputs) noexcept(false);
+
+	/**
+	 * @brief Validates partial signatures: same input file size,
+	 * algorithm and block size, full non-overlapping coverage of blocks.
+	 * @param verbose Level of additional information provided to the user
+	 * @return status
+	 * @value true partials can be merged
+	 * @value false fail
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	bool compute_signature(bool verbose) noexcept(true);
+
+	/**
+	 * @brief Concatenates validated partial signatures into the whole
+	 * fingerprint, the \a output file is replaced atomically.
+	 * @param output Path to the output result file
+	 * @return status
+	 * @value true success
+	 * @value false fail
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	bool save_signature(const string& output) const noexcept(true);
+};
+
+
+#endif /* SIGNATURESMERGER_H_ */
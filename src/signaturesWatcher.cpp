@@ -0,0 +1,242 @@
+
+#include "signaturesWatcher.h"
+
+
+volatile sig_atomic_t signaturesWatcher::stop_watching = 0;
+
+
+signaturesWatcher::signaturesWatcher(const string& input, const string& output,
+									 short bs, uint debounce_ms) noexcept(false)
+{
+	if (!filesystem::is_directory(input))
+		throw logic_error(std::string("Directory not found: ") + input);
+	this->input_dir = input;
+
+	if (!filesystem::is_directory(output))
+		throw logic_error(std::string("Directory not found: ") + output);
+	this->output_dir = output;
+
+	if ((bs <= 0) || (bs > 1024))
+		throw logic_error(std::string("Incorrect block size"));
+	this->block_size = bs;
+
+	this->debounce = chrono::milliseconds(debounce_ms);
+}
+
+
+void signaturesWatcher::on_stop_signal(int signum) noexcept(true)
+{
+	(void)signum;
+	stop_watching = 1;
+}
+
+
+bool signaturesWatcher::is_signature(const string& filename) const noexcept(true)
+{
+	const auto has_suffix = [&filename](const string& suffix) {
+		return (filename.size() >= suffix.size()) &&
+			   (filename.compare(filename.size() - suffix.size(), suffix.size(), suffix) == 0);
+	};
+
+	return has_suffix(".signa") || has_suffix(fileSignaturer::tmpoutput_suffix);
+}
+
+
+bool signaturesWatcher::is_watched(const string& filename) const noexcept(true)
+{
+	if (is_signature(filename))
+		return false;
+
+	error_code ec;
+	return filesystem::is_regular_file(filesystem::path(input_dir) / filename, ec);
+}
+
+
+bool signaturesWatcher::refresh_signature(const string& filename, bool verbose) noexcept(true)
+{
+	const string input = (filesystem::path(input_dir) / filename).string();
+	const string output = (filesystem::path(output_dir) / (filename + ".signa")).string();
+
+	try {
+		fileSignaturer fsigner(input, block_size);
+
+		if (!fsigner.compute_signature(verbose))
+			return false;
+
+		if (!fsigner.save_signature(output))
+			return false;
+	}
+	catch (exception& e) {
+		cerr << "Signature refreshing error for " << input << ": " << e.what() << endl;
+		return false;
+	}
+
+	cout << "Signature of " << input << " is up to date" << endl;
+	return true;
+}
+
+
+void signaturesWatcher::remove_signature(const string& filename) noexcept(true)
+{
+	if (is_signature(filename))
+		return;
+
+	const string output = (filesystem::path(output_dir) / (filename + ".signa")).string();
+	error_code ec;
+	if (filesystem::remove(output, ec))
+		cout << "Signature " << output << " removed" << endl;
+	else if (ec)
+		cerr << "Unable to remove " << output << ": " << ec.message() << endl;
+}
+
+
+void signaturesWatcher::queue_rescan() noexcept(true)
+{
+	cerr << "Change notifications lost, rescanning " << input_dir << endl;
+
+	try {
+		error_code ec;
+		const auto now = chrono::steady_clock::now();
+		for (auto it = filesystem::directory_iterator(input_dir, ec);
+			 it != filesystem::directory_iterator(); it.increment(ec)) {
+			if (ec)
+				break;
+			const string filename = it->path().filename().string();
+			if (is_watched(filename))
+				pending_files[filename] = now;
+		}
+		if (ec)
+			cerr << "Unable to list " << input_dir << ": " << ec.message() << endl;
+
+		// Signatures of the files deleted while notifications were lost
+		const string extension = ".signa";
+		for (auto it = filesystem::directory_iterator(output_dir, ec);
+			 it != filesystem::directory_iterator(); it.increment(ec)) {
+			if (ec)
+				break;
+			const string signame = it->path().filename().string();
+			if ((signame.size() <= extension.size()) ||
+				(signame.compare(signame.size() - extension.size(), extension.size(), extension) != 0))
+				continue;
+			const string filename = signame.substr(0, signame.size() - extension.size());
+			error_code exists_ec;
+			if (!filesystem::exists(filesystem::path(input_dir) / filename, exists_ec) && !exists_ec)
+				remove_signature(filename);
+		}
+		if (ec)
+			cerr << "Unable to list " << output_dir << ": " << ec.message() << endl;
+	}
+	catch (exception& e) {
+		cerr << "Rescanning error: " << e.what() << endl;
+	}
+}
+
+
+int signaturesWatcher::flush_pending(bool verbose) noexcept(true)
+{
+	int timeout = -1;
+	const auto now = chrono::steady_clock::now();
+
+	for (auto it = pending_files.begin(); it != pending_files.end(); ) {
+		const auto quiet = chrono::duration_cast<chrono::milliseconds>(now - it->second);
+		if (quiet >= debounce) {
+			if (is_watched(it->first))
+				refresh_signature(it->first, verbose);
+			it = pending_files.erase(it);
+		} else {
+			const int left = static_cast<int>((debounce - quiet).count());
+			if ((timeout < 0) || (left < timeout))
+				timeout = left;
+			++it;
+		}
+	}
+
+	return timeout;
+}
+
+
+bool signaturesWatcher::run(bool verbose) noexcept(true)
+{
+#if defined(__linux__)
+	stop_watching = 0;
+	signal(SIGINT, on_stop_signal);
+	signal(SIGTERM, on_stop_signal);
+
+	// Subscribe before the initial pass, so changes made during it are not lost
+	const int inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify_fd < 0) {
+		cerr << "Unable to initialize change notifications: " << strerror(errno) << endl;
+		return false;
+	}
+	if (inotify_add_watch(inotify_fd, input_dir.c_str(),
+						  IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM) < 0) {
+		cerr << "Unable to watch " << input_dir << ": " << strerror(errno) << endl;
+		close(inotify_fd);
+		return false;
+	}
+
+	// Initial pass over existing files (non-throwing iteration: entries may
+	// disappear or become inaccessible during the pass)
+	error_code ec;
+	for (auto it = filesystem::directory_iterator(input_dir, ec);
+		 it != filesystem::directory_iterator(); it.increment(ec)) {
+		if ((ec) || (stop_watching))
+			break;
+		const string filename = it->path().filename().string();
+		if (is_watched(filename))
+			refresh_signature(filename, verbose);
+	}
+	if (ec)
+		cerr << "Unable to list " << input_dir << ": " << ec.message() << endl;
+
+	cout << "Watching " << input_dir << " for changes..." << endl;
+
+	alignas(inotify_event) char events_buf[64 * (sizeof(inotify_event) + NAME_MAX + 1)];
+	pollfd pfd{inotify_fd, POLLIN, 0};
+
+	while (!stop_watching) {
+		const int ready = poll(&pfd, 1, flush_pending(verbose));
+		if (ready < 0) {
+			if (errno == EINTR)
+				continue;
+			cerr << "Change notifications error: " << strerror(errno) << endl;
+			close(inotify_fd);
+			return false;
+		}
+		if (ready == 0)
+			continue;
+
+		ssize_t len;
+		while ((len = read(inotify_fd, events_buf, sizeof(events_buf))) > 0) {
+			for (char* ptr = events_buf; ptr < events_buf + len; ) {
+				const auto event = reinterpret_cast<const inotify_event*>(ptr);
+				ptr += sizeof(inotify_event) + event->len;
+
+				// Events have been dropped, any file may have changed
+				if (event->mask & IN_Q_OVERFLOW) {
+					queue_rescan();
+					continue;
+				}
+				if (!event->len)
+					continue;
+
+				// Every new change of a file restarts its quiet period
+				if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+					pending_files[event->name] = chrono::steady_clock::now();
+				else {
+					pending_files.erase(event->name);
+					remove_signature(event->name);
+				}
+			}
+		}
+	}
+
+	close(inotify_fd);
+	cout << "Watching stopped" << endl;
+	return true;
+#else
+	(void)verbose;
+	cerr << "Watch mode is not supported on this platform" << endl;
+	return false;
+#endif
+}
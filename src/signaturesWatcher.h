@@ -0,0 +1,168 @@
+
+#ifndef SIGNATURESWATCHER_H_
+#define SIGNATURESWATCHER_H_
+
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <climits>
+#if defined(__linux__)
+	#include <poll.h>
+	#include <unistd.h>
+	#include <sys/inotify.h>
+#endif
+
+#include "fileSignaturer.h"
+
+
+/**
+ * @class signaturesWatcher
+ * @brief Daemon keeping fingerprints of a directory's files up to date.
+ * Fingerprints every regular file of the input directory once, then subscribes
+ * to the directory's change notifications (inotify) and re-fingerprints only
+ * the files which have been modified, after their changes calm down.
+ * Signature of the input file NAME is stored as NAME.signa in the output directory
+ * and is removed together with the file.
+ */
+class signaturesWatcher
+{
+protected:
+
+	/**
+	 * @brief Valid path to user provided watched directory.
+	 */
+	string input_dir;
+
+	/**
+	 * @brief Valid path to user provided directory for signatures.
+	 */
+	string output_dir;
+
+	/**
+	 * @brief Given size of the input files' hashing unit (in Mb).
+	 */
+	short block_size;
+
+	/**
+	 * @brief Quiet period after the last change of a file before
+	 * the file is re-fingerprinted.
+	 */
+	chrono::milliseconds debounce;
+
+	/**
+	 * @brief Files with pending changes and the moment of their last change.
+	 * @see debounce
+	 */
+	map<string, chrono::steady_clock::time_point> pending_files;
+
+	/**
+	 * @brief Notifiable flag of the daemon shutdown, raised by
+	 * SIGINT or SIGTERM signal handler.
+	 */
+	static volatile sig_atomic_t stop_watching;
+
+	/**
+	 * @brief Handler of SIGINT and SIGTERM signals.
+	 * @param signum Signal number
+	 *
+	 * @see stop_watching
+	 */
+	static void on_stop_signal(int signum) noexcept(true);
+
+	/**
+	 * @brief Checks whether a file name is a signature or a temporary signature.
+	 * @param filename Name of a file
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	virtual bool is_signature(const string& filename) const noexcept(true);
+
+	/**
+	 * @brief Checks whether a file of the watched directory should be fingerprinted.
+	 * Signatures and temporary signatures are skipped
+	 * in case the output directory is the watched one.
+	 * @param filename Name of a file inside the watched directory
+	 * @return status
+	 * @value true fingerprint is needed
+	 * @value false file is skipped
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	virtual bool is_watched(const string& filename) const noexcept(true);
+
+	/**
+	 * @brief Computes fingerprint of the \a filename file and atomically
+	 * replaces its signature in the output directory.
+	 * @param filename Name of a file inside the watched directory
+	 * @param verbose Level of additional information provided to the user
+	 * @return status
+	 * @value true success
+	 * @value false fail
+	 * @exceptsafe Shall not throw exceptions.
+	 *
+	 * @see fileSignaturer
+	 */
+	virtual bool refresh_signature(const string& filename, bool verbose) noexcept(true);
+
+	/**
+	 * @brief Removes signature of the deleted (or moved away) \a filename file
+	 * from the output directory.
+	 * @param filename Name of a former file of the watched directory
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	virtual void remove_signature(const string& filename) noexcept(true);
+
+	/**
+	 * @brief Queues all files of the watched directory for re-fingerprinting
+	 * and removes signatures of the files which no longer exist. Used when
+	 * change notifications have been lost (notifications queue overflow).
+	 * @exceptsafe Shall not throw exceptions.
+	 *
+	 * @see pending_files
+	 */
+	virtual void queue_rescan() noexcept(true);
+
+	/**
+	 * @brief Re-fingerprints files which changes are older than \a debounce.
+	 * @param verbose Level of additional information provided to the user
+	 * @return Time left until the next pending file calms down,
+	 * -1 if there are no pending files (poll() timeout)
+	 * @exceptsafe Shall not throw exceptions.
+	 *
+	 * @see pending_files
+	 */
+	virtual int flush_pending(bool verbose) noexcept(true);
+
+public:
+
+	/**
+	 * @brief Creates instance of the signaturesWatcher class.
+	 * @param input Path to the watched directory
+	 * @param output Path to the directory for signatures
+	 * @param bs Block size (in Mb, up to 1Gb, default: 1)
+	 * @param debounce_ms Quiet period after a file change (in milliseconds)
+	 * @throws logic_error Directories not found, incorrect parameters
+	 * @exceptsafe strong
+	 */
+	signaturesWatcher(const string& input, const string& output,
+					  short bs, uint debounce_ms) noexcept(false);
+
+	/**
+	 * @brief Fingerprints all files of the watched directory and keeps
+	 * their signatures current until SIGINT or SIGTERM is received.
+	 * @param verbose Level of additional information provided to the user
+	 * @return status
+	 * @value true daemon has been stopped by a signal
+	 * @value false watching is impossible
+	 * @exceptsafe Shall not throw exceptions.
+	 *
+	 * @see refresh_signature(), flush_pending()
+	 */
+	bool run(bool verbose) noexcept(true);
+
+	/**
+	 * @brief Destructor of the signaturesWatcher class.
+	 */
+	virtual ~signaturesWatcher() = default;
+};
+
+
+#endif /* SIGNATURESWATCHER_H_ */
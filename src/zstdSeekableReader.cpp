@@ -0,0 +1,211 @@
+
+#include "zstdSeekableReader.h"
+
+
+namespace {
+	constexpr uint32_t skippable_magic = 0x184D2A5E;
+	constexpr uint32_t seekable_magic = 0x8F92EAB1;
+	// Number_Of_Frames, Seek_Table_Descriptor, Seekable_Magic_Number
+	constexpr size_t footer_size = 9;
+	// Skippable_Magic_Number, Frame_Size
+	constexpr size_t skippable_header_size = 8;
+	constexpr unsigned char checksum_flag = 0x80;
+	constexpr unsigned char reserved_bits = 0x7C;
+
+	// All of the format's numbers are little-endian
+	uint32_t read_le32(const unsigned char* bytes)
+	{
+		return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+			   (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+	}
+}
+
+
+bool zstdSeekableReader::is_supported() noexcept(true)
+{
+#if defined(SIGNA_WITH_ZSTD)
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+zstdSeekableReader::zstdSeekableReader(const string& input, shared_ptr<ioThrottle> throttle) noexcept(false)
+#if defined(SIGNA_WITH_ZSTD)
+	: dctx(ZSTD_createDCtx(), ZSTD_freeDCtx)
+#endif
+{
+	if (!is_supported())
+		throw logic_error(std::string("zstd support is not built in"));
+
+#if defined(SIGNA_WITH_ZSTD)
+	if (!dctx)
+		throw runtime_error(std::string("zstd decompression context error"));
+#endif
+
+	this->input_file = input;
+	this->io_throttle = throttle;
+	if_input.exceptions( ifstream::failbit | ifstream::badbit );
+	if_input.open(input_file, ios_base::in | ios_base::binary);
+
+	read_seektable();
+	this->current_frame = frames.size();
+	this->frame_pos = 0;
+	this->compressed_left = 0;
+	this->chunk_pos = 0;
+	this->chunk_length = 0;
+
+#if defined(SIGNA_WITH_ZSTD)
+	compressed_chunk.resize(ZSTD_DStreamInSize());
+	skipped_data.resize(ZSTD_DStreamOutSize());
+#endif
+}
+
+
+void zstdSeekableReader::read_seektable() noexcept(false)
+{
+	if_input.seekg(0, ios_base::end);
+	const uintmax_t file_size = static_cast<uintmax_t>(if_input.tellg());
+	if (file_size < skippable_header_size + footer_size)
+		throw logic_error(input_file + " is not in the zstd seekable format");
+
+	unsigned char footer[footer_size];
+	if_input.seekg(file_size - footer_size);
+	if_input.read(reinterpret_cast<char*>(footer), footer_size);
+	const uint32_t frames_num = read_le32(footer);
+	const unsigned char descriptor = footer[4];
+	if ((read_le32(footer + 5) != seekable_magic) || (descriptor & reserved_bits))
+		throw logic_error(input_file + " is not in the zstd seekable format");
+
+	const size_t entry_size = (descriptor & checksum_flag) ? 12 : 8;
+	const uintmax_t table_size = static_cast<uintmax_t>(frames_num) * entry_size;
+	if (file_size < skippable_header_size + table_size + footer_size)
+		throw logic_error(input_file + " has a corrupted seek table");
+	const uintmax_t table_start = file_size - footer_size - table_size - skippable_header_size;
+
+	vector<unsigned char> table(skippable_header_size + table_size);
+	if_input.seekg(table_start);
+	if_input.read(reinterpret_cast<char*>(table.data()), table.size());
+	if ((read_le32(table.data()) != skippable_magic) ||
+		(read_le32(table.data() + 4) != table_size + footer_size))
+		throw logic_error(input_file + " has a corrupted seek table");
+
+	uintmax_t compressed_offset = 0;
+	decompressed_size = 0;
+	for (uint32_t i = 0; i < frames_num; ++i) {
+		const unsigned char* entry = table.data() + skippable_header_size + i * entry_size;
+		const frame_settings frame{compressed_offset, read_le32(entry),
+								   decompressed_size, read_le32(entry + 4)};
+		compressed_offset += frame.compressed_size;
+		decompressed_size += frame.decompressed_size;
+		if (frame.decompressed_size > 0)
+			frames.push_back(frame);
+	}
+
+	// Frames occupy everything in front of the seek table
+	if (compressed_offset != table_start)
+		throw logic_error(input_file + " seek table doesn't match the frames");
+}
+
+
+void zstdSeekableReader::start_frame(size_t index) noexcept(false)
+{
+#if defined(SIGNA_WITH_ZSTD)
+	const frame_settings& frame = frames.at(index);
+
+	const size_t result = ZSTD_DCtx_reset(dctx.get(), ZSTD_reset_session_only);
+	if (ZSTD_isError(result))
+		throw runtime_error(std::string("zstd decompression context error: ") + ZSTD_getErrorName(result));
+
+	if_input.seekg(frame.compressed_offset);
+	current_frame = index;
+	frame_pos = 0;
+	compressed_left = frame.compressed_size;
+	chunk_pos = 0;
+	chunk_length = 0;
+#else
+	(void)index;
+	throw logic_error(std::string("zstd support is not built in"));
+#endif
+}
+
+
+void zstdSeekableReader::decompress(char* buffer, uintmax_t length) noexcept(false)
+{
+#if defined(SIGNA_WITH_ZSTD)
+	ZSTD_outBuffer output{buffer, static_cast<size_t>(length), 0};
+
+	while (output.pos < output.size) {
+		// Compressed data is read by small pieces too
+		if (chunk_pos == chunk_length) {
+			if (!compressed_left)
+				throw runtime_error(input_file + " frame " + to_string(current_frame) +
+									" size doesn't match the seek table");
+			chunk_length = static_cast<size_t>(min(static_cast<uintmax_t>(compressed_chunk.size()),
+												   compressed_left));
+			if (io_throttle) {
+				io_throttle->acquire(chunk_length);
+				const auto read_start = chrono::steady_clock::now();
+				if_input.read(compressed_chunk.data(), chunk_length);
+				io_throttle->report(chunk_length, chrono::steady_clock::now() - read_start);
+			} else
+				if_input.read(compressed_chunk.data(), chunk_length);
+			compressed_left -= chunk_length;
+			chunk_pos = 0;
+		}
+
+		ZSTD_inBuffer input{compressed_chunk.data(), chunk_length, chunk_pos};
+		const size_t result = ZSTD_decompressStream(dctx.get(), &output, &input);
+		chunk_pos = input.pos;
+		if (ZSTD_isError(result))
+			throw runtime_error(input_file + " frame " + to_string(current_frame) +
+								" decompression error: " + ZSTD_getErrorName(result));
+		if ((result == 0) && (output.pos < output.size))
+			throw runtime_error(input_file + " frame " + to_string(current_frame) +
+								" size doesn't match the seek table");
+	}
+
+	frame_pos += length;
+#else
+	(void)buffer;
+	(void)length;
+	throw logic_error(std::string("zstd support is not built in"));
+#endif
+}
+
+
+uintmax_t zstdSeekableReader::size() const noexcept(true)
+{
+	return decompressed_size;
+}
+
+
+void zstdSeekableReader::read(uintmax_t pos, char* buffer, uintmax_t length) noexcept(false)
+{
+	if (pos + length > decompressed_size)
+		throw runtime_error(input_file + " error on read (unexpected eof)");
+
+	while (length > 0) {
+		// The frame containing pos: the last one starting not after pos
+		const auto frame = upper_bound(frames.begin(), frames.end(), pos,
+				[](uintmax_t position, const frame_settings& settings) {
+					return position < settings.decompressed_offset; }) - 1;
+		const size_t index = static_cast<size_t>(frame - frames.begin());
+		const uintmax_t offset = pos - frame->decompressed_offset;
+		if ((index != current_frame) || (offset < frame_pos))
+			start_frame(index);
+
+		// Decompression can't seek inside a frame: data up to pos is skipped
+		while (frame_pos < offset)
+			decompress(skipped_data.data(), min(static_cast<uintmax_t>(skipped_data.size()),
+												offset - frame_pos));
+
+		const uintmax_t piece = min(length, frame->decompressed_size - offset);
+		decompress(buffer, piece);
+
+		pos += piece;
+		buffer += piece;
+		length -= piece;
+	}
+}
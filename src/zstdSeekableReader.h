@@ -0,0 +1,175 @@
+
+#ifndef ZSTDSEEKABLEREADER_H_
+#define ZSTDSEEKABLEREADER_H_
+
+#include <fstream>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+#include <algorithm>
+#include "ioThrottle.h"
+#if __has_include(<zstd.h>)
+	#include <zstd.h>
+	#define SIGNA_WITH_ZSTD 1
+#endif
+using namespace std;
+
+
+/**
+ * @class zstdSeekableReader
+ * @brief Random access reader of the uncompressed contents of a file in the
+ * zstd seekable format (independent zstd frames followed by a seek table
+ * in a skippable frame). Only the frames covering the requested data are
+ * decompressed, progressively (streaming decompression into the caller's
+ * buffer), so memory consumption doesn't depend on the frames' sizes.
+ * Sequential reads continue the current frame. One instance is used by one
+ * thread, so frames of different parts of the file are decompressed in
+ * parallel by different threads. Available when built with libzstd.
+ */
+class zstdSeekableReader
+{
+protected:
+
+	/**
+	 * @brief Position of a zstd frame in the compressed and uncompressed data.
+	 */
+	struct frame_settings
+	{
+		uintmax_t compressed_offset;
+		uint32_t compressed_size;
+		uintmax_t decompressed_offset;
+		uint32_t decompressed_size;
+	};
+
+	/**
+	 * @brief Valid path to the compressed file.
+	 */
+	string input_file;
+
+	/**
+	 * @brief Compressed file opened for reading.
+	 */
+	ifstream if_input;
+
+	/**
+	 * @brief Optional limiter of the compressed file reading.
+	 */
+	shared_ptr<ioThrottle> io_throttle;
+
+	/**
+	 * @brief Frames of the compressed file from its seek table.
+	 */
+	vector<frame_settings> frames;
+
+	/**
+	 * @brief Size of the uncompressed contents (in bytes).
+	 */
+	uintmax_t decompressed_size;
+
+	/**
+	 * @brief Index of the frame being decompressed (frames.size() - none).
+	 */
+	size_t current_frame;
+
+	/**
+	 * @brief Quantity of the current frame's bytes already decompressed.
+	 */
+	uintmax_t frame_pos;
+
+	/**
+	 * @brief Quantity of the current frame's compressed bytes not read yet.
+	 */
+	uintmax_t compressed_left;
+
+	/**
+	 * @brief Piece of the current frame's compressed data.
+	 */
+	vector<char> compressed_chunk;
+
+	/**
+	 * @brief Position of the not yet decompressed data in \a compressed_chunk.
+	 */
+	size_t chunk_pos;
+
+	/**
+	 * @brief Quantity of the data in \a compressed_chunk.
+	 */
+	size_t chunk_length;
+
+	/**
+	 * @brief Destination of the decompressed data skipped up to a requested position.
+	 */
+	vector<char> skipped_data;
+
+#if defined(SIGNA_WITH_ZSTD)
+	/**
+	 * @brief Decompression context reused for all of the frames.
+	 */
+	unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> dctx;
+#endif
+
+	/**
+	 * @brief Reads and checks the seek table at the end of the compressed file.
+	 * @throws logic_error The file is not in the zstd seekable format
+	 * @throws runtime_error File system access errors
+	 */
+	virtual void read_seektable() noexcept(false);
+
+	/**
+	 * @brief Starts decompression of a frame from its beginning.
+	 * @param index Index of the frame
+	 * @throws runtime_error File system access errors
+	 */
+	virtual void start_frame(size_t index) noexcept(false);
+
+	/**
+	 * @brief Continues decompression of the current frame.
+	 * @param buffer Destination
+	 * @param length Quantity of bytes to decompress, shall not exceed the rest of the frame
+	 * @throws runtime_error File system access errors, corrupted frame
+	 */
+	virtual void decompress(char* buffer, uintmax_t length) noexcept(false);
+
+public:
+
+	/**
+	 * @brief Checks whether zstd support is built in.
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	static bool is_supported() noexcept(true);
+
+	/**
+	 * @brief Creates instance of the zstdSeekableReader class.
+	 * @param input Path to the compressed file
+	 * @param throttle Limiter of the compressed data reading (nullptr - no limits),
+	 * charged with compressed bytes
+	 * @throws logic_error The file is not in the zstd seekable format,
+	 * zstd support is not built in
+	 * @throws runtime_error File system access errors
+	 * @exceptsafe strong
+	 */
+	zstdSeekableReader(const string& input, shared_ptr<ioThrottle> throttle = nullptr) noexcept(false);
+
+	/**
+	 * @brief Size of the uncompressed contents (in bytes).
+	 * @exceptsafe Shall not throw exceptions.
+	 */
+	uintmax_t size() const noexcept(true);
+
+	/**
+	 * @brief Reads uncompressed contents.
+	 * @param pos Position in the uncompressed contents
+	 * @param buffer Destination
+	 * @param length Quantity of bytes to read, \a pos + \a length shall not exceed size()
+	 * @throws runtime_error File system access errors, corrupted frame
+	 */
+	void read(uintmax_t pos, char* buffer, uintmax_t length) noexcept(false);
+
+	/**
+	 * @brief Destructor of the zstdSeekableReader class.
+	 */
+	virtual ~zstdSeekableReader() = default;
+};
+
+
+#endif /* ZSTDSEEKABLEREADER_H_ */